@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <boost/format.hpp>
+#include <string>
+#include <vector>
+#include "PoolObject.hpp"
+#include "ObjectPool.hpp"
+#include "Clock.hpp"
+#include "Log.hpp"
+#include "EventScheduler.hpp"
+#include "TcpServer.hpp"
+
+//
+// churnbench [seconds] [concurrency]
+//   short lived loopback connections, each client connects, sends one
+//   request, reads the reply and closes. the server closes its side after
+//   the reply, like http/1.0. the client interfaces of the server come from
+//   the worker slab pool, its occupancy is dumped at the end. a second run
+//   compares pool Alloc/Free with new/delete of the same objects.
+//
+class ChurnServer :
+    public TcpServer<ChurnServer>
+{
+public:
+    ChurnServer() :
+        m_Requests(0)
+    {
+    }
+
+    void OnMessage(ChannelType& channel, IOBuffer& in)
+    {
+        in.ReadSeek(in.GetReadSize());
+        ++m_Requests;
+
+        this->Send(channel, "HTTP/1.0 200 OK\r\n\r\n", 19);
+        shutdown(channel.Socket, SHUT_WR);
+    }
+
+    uint64_t m_Requests;
+};
+
+class ChurnClient
+{
+public:
+    ChurnClient(sockaddr_in& addr, uint64_t deadline) :
+        m_Address(addr),
+        m_Deadline(deadline),
+        m_Connections(0),
+        m_Errors(0)
+    {
+    }
+
+    bool Start()
+    {
+        ServerInterface<int>* pInterface = new ServerInterface<int>();
+        pInterface->m_Channel.Socket = socket(PF_INET, SOCK_STREAM|SOCK_CLOEXEC, 0);
+        pInterface->m_Channel.Data = 0;
+        if(-1 == connect(pInterface->m_Channel.Socket, (sockaddr*)&m_Address, sizeof(sockaddr_in)) ||
+           -1 == send(pInterface->m_Channel.Socket, "GET / HTTP/1.0\r\n\r\n", 18, 0))
+        {
+            close(pInterface->m_Channel.Socket);
+            delete pInterface;
+            ++m_Errors;
+            return false;
+        }
+
+        pInterface->m_ReadableCallback = boost::bind(&ChurnClient::OnReadable, this, _1);
+        PoolObject<EventScheduler>::Instance().Register(pInterface, EventScheduler::PollType::IN);
+        return true;
+    }
+
+    void OnReadable(ServerInterface<int>* pInterface)
+    {
+        char buffer[1024];
+        ssize_t size = recv(pInterface->m_Channel.Socket, buffer, sizeof(buffer), 0);
+        if(size > 0)
+            return;
+
+        PoolObject<EventScheduler>::Instance().UnRegister(pInterface);
+        close(pInterface->m_Channel.Socket);
+        delete pInterface;
+        ++m_Connections;
+
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        if((uint64_t)tv.tv_sec * 1000000 + tv.tv_usec >= m_Deadline)
+        {
+            // drain, quit when the last client is done.
+            if(--m_Live == 0)
+                PoolObject<EventScheduler>::Instance().Quit();
+            return;
+        }
+
+        if(!Start())
+            --m_Live;
+    }
+
+    sockaddr_in m_Address;
+    uint64_t m_Deadline;
+    uint64_t m_Connections;
+    uint64_t m_Errors;
+    int m_Live;
+};
+
+void RunChurn(int seconds, int concurrency)
+{
+    EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
+    if(scheduler.CreateScheduler(EPOLL_DEFAULT_MAXEVENTS) == -1)
+    {
+        printf("error: create scheduler fail, %s\n", safe_strerror(errno));
+        return;
+    }
+
+    ChurnServer server;
+
+    sockaddr_in addr;
+    bzero(&addr, sizeof(sockaddr_in));
+    addr.sin_family = PF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    socklen_t len = sizeof(sockaddr_in);
+
+    if(-1 == server.Listen(addr) ||
+       -1 == getsockname(server.m_ServerInterface.m_Channel.Socket, (sockaddr*)&addr, &len) ||
+       -1 == scheduler.Register(&server, EventScheduler::PollType::IN))
+    {
+        printf("error: listen fail, %s\n", safe_strerror(errno));
+        scheduler.Close();
+        return;
+    }
+
+    timeval start;
+    gettimeofday(&start, NULL);
+
+    ChurnClient client(addr, (uint64_t)start.tv_sec * 1000000 + start.tv_usec + (uint64_t)seconds * 1000000);
+    client.m_Live = 0;
+    for(int i = 0; i < concurrency; ++i)
+    {
+        if(client.Start())
+            ++client.m_Live;
+    }
+
+    if(client.m_Live > 0)
+        scheduler.Dispatch();
+
+    timeval end;
+    gettimeofday(&end, NULL);
+    double span = CLOCK_COMPUTE_TIMESPAN(start, end) / 1000;
+
+    printf("connections: %12.0f conn/s, requests: %llu, errors: %llu\n",
+            client.m_Connections / span,
+            (unsigned long long)server.m_Requests,
+            (unsigned long long)client.m_Errors);
+
+    std::string strDump;
+    server.DumpClientPool(strDump);
+    printf("%s", strDump.c_str());
+
+    scheduler.UnRegister(&server);
+    close(server.m_ServerInterface.m_Channel.Socket);
+    scheduler.Close();
+}
+
+// the same allocation pattern as the server, live objects in random order.
+template<typename ObjectT>
+void RunAlloc(int live, int rounds)
+{
+    ObjectPool<ObjectT> pool;
+    std::vector<ObjectT*> objects(live, (ObjectT*)NULL);
+
+    srand(1);
+    uint64_t begin = ReadCycleCounter();
+    for(int i = 0; i < rounds; ++i)
+    {
+        int idx = rand() % live;
+        pool.Free(objects[idx]);
+        objects[idx] = pool.Alloc();
+    }
+    uint64_t pooled = ReadCycleCounter() - begin;
+
+    for(int i = 0; i < live; ++i)
+    {
+        pool.Free(objects[i]);
+        objects[i] = NULL;
+    }
+
+    srand(1);
+    begin = ReadCycleCounter();
+    for(int i = 0; i < rounds; ++i)
+    {
+        int idx = rand() % live;
+        delete objects[idx];
+        objects[idx] = new ObjectT();
+    }
+    uint64_t heap = ReadCycleCounter() - begin;
+
+    for(int i = 0; i < live; ++i)
+        delete objects[i];
+
+    printf("alloc %lu bytes, %d live: pool %llu cycles/op, new/delete %llu cycles/op\n",
+            (unsigned long)sizeof(ObjectT), live,
+            (unsigned long long)(pooled / rounds),
+            (unsigned long long)(heap / rounds));
+}
+
+int main(int argc, char* argv[])
+{
+    int seconds = 3;
+    int concurrency = 16;
+
+    if(argc > 1)
+        seconds = atoi(argv[1]);
+    if(argc > 2)
+        concurrency = atoi(argv[2]);
+
+    if(concurrency < 1)
+    {
+        printf("usage: %s [seconds] [concurrency]\n", argv[0]);
+        return -1;
+    }
+
+    RunChurn(seconds, concurrency);
+    RunAlloc<ServerInterface<TcpChannelCache<void, 65535> > >(concurrency, 1000000);
+    RunAlloc<ServerInterface<TcpChannelCache<void, 0> > >(concurrency, 1000000);
+    return 0;
+}
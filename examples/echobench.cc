@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <boost/format.hpp>
+#include <vector>
+#include "PoolObject.hpp"
+#include "Clock.hpp"
+#include "Log.hpp"
+#include "Server.hpp"
+#include "EventScheduler.hpp"
+#include "IoUring.hpp"
+
+//
+// echobench [connections] [seconds] [message size]
+//   loopback tcp echo, server and clients share one loop. each client sends
+//   a message when the previous echo is back, the same loop runs once with
+//   EPoll and once with IoUring. sockets are registered with RECV and ACCEPT
+//   and read through the poller, a multishot recv and accept on IoUring.
+//
+template<typename PollT>
+class EchoBench
+{
+public:
+    EchoBench(EventSchedulerImpl<PollT>& scheduler, uint64_t deadline, size_t size) :
+        m_Scheduler(scheduler),
+        m_Deadline(deadline),
+        m_MessageSize(size),
+        m_Echos(0)
+    {
+    }
+
+    void OnAcceptable(ServerInterface<int>* pInterface)
+    {
+        sockaddr_in addr;
+        int clifd = m_Scheduler.GetPoll().Accept(pInterface->m_Channel.Socket, &addr, SOCK_CLOEXEC);
+        if(clifd == -1)
+            return;
+
+        int nodelay = 1;
+        setsockopt(clifd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(int));
+
+        ServerInterface<int>* pServerInterface = new ServerInterface<int>();
+        pServerInterface->m_Channel.Socket = clifd;
+        pServerInterface->m_Channel.Data = 0;
+        pServerInterface->m_ReadableCallback = boost::bind(&EchoBench<PollT>::OnServerReadable, this, _1);
+        m_Scheduler.Register(pServerInterface, PollT::IN | PollT::RECV);
+        m_Interfaces.push_back(pServerInterface);
+    }
+
+    ssize_t Recv(ServerInterface<int>* pInterface, char* buffer, size_t size)
+    {
+        iovec iov;
+        iov.iov_base = buffer;
+        iov.iov_len = size;
+        return m_Scheduler.GetPoll().Recv(pInterface->m_Channel.Socket, &iov, 1);
+    }
+
+    void OnServerReadable(ServerInterface<int>* pInterface)
+    {
+        char buffer[65536];
+        ssize_t size = Recv(pInterface, buffer, sizeof(buffer));
+        if(size > 0)
+            send(pInterface->m_Channel.Socket, buffer, size, 0);
+    }
+
+    void OnClientReadable(ServerInterface<int>* pInterface)
+    {
+        char buffer[65536];
+        ssize_t size = Recv(pInterface, buffer, sizeof(buffer));
+        if(size <= 0)
+            return;
+
+        pInterface->m_Channel.Data += size;
+        if((size_t)pInterface->m_Channel.Data >= m_MessageSize)
+        {
+            pInterface->m_Channel.Data = 0;
+            ++m_Echos;
+            send(pInterface->m_Channel.Socket, m_Message.c_str(), m_MessageSize, 0);
+        }
+    }
+
+    void OnLoop()
+    {
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        if((uint64_t)tv.tv_sec * 1000000 + tv.tv_usec >= m_Deadline)
+            m_Scheduler.Quit();
+    }
+
+    EventSchedulerImpl<PollT>& m_Scheduler;
+    uint64_t m_Deadline;
+    size_t m_MessageSize;
+    uint64_t m_Echos;
+    std::string m_Message;
+    std::vector<ServerInterface<int>*> m_Interfaces;
+};
+
+template<typename PollT>
+double RunBench(int connections, int seconds, size_t size)
+{
+    EventSchedulerImpl<PollT> scheduler;
+    if(scheduler.CreateScheduler(EPOLL_DEFAULT_MAXEVENTS) == -1)
+    {
+        printf("error: create scheduler fail, %s\n", safe_strerror(errno));
+        return 0;
+    }
+
+    timeval start;
+    gettimeofday(&start, NULL);
+    uint64_t begin = (uint64_t)start.tv_sec * 1000000 + start.tv_usec;
+
+    EchoBench<PollT> bench(scheduler, begin + (uint64_t)seconds * 1000000, size);
+    bench.m_Message.assign(size, 'x');
+    scheduler.RegisterLoopCallback(boost::bind(&EchoBench<PollT>::OnLoop, &bench));
+
+    ServerInterface<int> stListener;
+    stListener.m_Channel.Socket = socket(PF_INET, SOCK_STREAM|SOCK_CLOEXEC, 0);
+
+    sockaddr_in addr;
+    bzero(&addr, sizeof(sockaddr_in));
+    addr.sin_family = PF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    socklen_t len = sizeof(sockaddr_in);
+
+    if(-1 == bind(stListener.m_Channel.Socket, (sockaddr*)&addr, sizeof(sockaddr_in)) ||
+       -1 == listen(stListener.m_Channel.Socket, 1024) ||
+       -1 == getsockname(stListener.m_Channel.Socket, (sockaddr*)&addr, &len))
+    {
+        printf("error: listen fail, %s\n", safe_strerror(errno));
+        close(stListener.m_Channel.Socket);
+        return 0;
+    }
+
+    stListener.m_ReadableCallback = boost::bind(&EchoBench<PollT>::OnAcceptable, &bench, _1);
+    scheduler.Register(&stListener, PollT::IN | PollT::ACCEPT);
+
+    for(int i = 0; i < connections; ++i)
+    {
+        ServerInterface<int>* pInterface = new ServerInterface<int>();
+        pInterface->m_Channel.Socket = socket(PF_INET, SOCK_STREAM|SOCK_CLOEXEC, 0);
+        pInterface->m_Channel.Data = 0;
+        if(-1 == connect(pInterface->m_Channel.Socket, (sockaddr*)&addr, sizeof(sockaddr_in)))
+        {
+            printf("error: connect fail, %s\n", safe_strerror(errno));
+            close(pInterface->m_Channel.Socket);
+            delete pInterface;
+            break;
+        }
+
+        int nodelay = 1;
+        setsockopt(pInterface->m_Channel.Socket, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(int));
+
+        pInterface->m_ReadableCallback = boost::bind(&EchoBench<PollT>::OnClientReadable, &bench, _1);
+        scheduler.Register(pInterface, PollT::IN | PollT::RECV);
+        bench.m_Interfaces.push_back(pInterface);
+
+        send(pInterface->m_Channel.Socket, bench.m_Message.c_str(), size, 0);
+    }
+
+    scheduler.Dispatch();
+
+    timeval end;
+    gettimeofday(&end, NULL);
+    double span = CLOCK_COMPUTE_TIMESPAN(start, end) / 1000;
+
+    for(typename std::vector<ServerInterface<int>*>::iterator iter = bench.m_Interfaces.begin();
+        iter != bench.m_Interfaces.end();
+        ++iter)
+    {
+        scheduler.UnRegister(*iter);
+        close((*iter)->m_Channel.Socket);
+        delete *iter;
+    }
+    scheduler.UnRegister(&stListener);
+    close(stListener.m_Channel.Socket);
+    scheduler.Close();
+
+    return bench.m_Echos / span;
+}
+
+int main(int argc, char* argv[])
+{
+    int connections = 100;
+    int seconds = 3;
+    size_t size = 64;
+
+    if(argc > 1)
+        connections = atoi(argv[1]);
+    if(argc > 2)
+        seconds = atoi(argv[2]);
+    if(argc > 3)
+        size = strtoul(argv[3], NULL, 10);
+
+    double epoll = RunBench<EPoll>(connections, seconds, size);
+    printf("EPoll   : %12.0f echo/s\n", epoll);
+
+    double uring = RunBench<IoUring>(connections, seconds, size);
+    printf("IoUring : %12.0f echo/s\n", uring);
+
+    if(epoll > 0)
+        printf("ratio: %.02fx\n", uring / epoll);
+    return 0;
+}
+
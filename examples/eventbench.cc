@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <boost/format.hpp>
+#include <vector>
+#include "PoolObject.hpp"
+#include "Clock.hpp"
+#include "Log.hpp"
+#include "Server.hpp"
+#include "EventScheduler.hpp"
+
+//
+// eventbench [pairs] [seconds] [max_events]
+//   every readable socket reads one byte and writes it back to its peer,
+//   so all pairs stay ready and the loop runs at the dispatch limit.
+//
+class EventBench
+{
+public:
+    EventBench(EventScheduler& scheduler, uint64_t deadline) :
+        m_Scheduler(scheduler),
+        m_Deadline(deadline),
+        m_Events(0),
+        m_Loops(0)
+    {
+    }
+
+    void OnReadable(ServerInterface<int>* pInterface)
+    {
+        char c;
+        if(read(pInterface->m_Channel.Socket, &c, 1) == 1)
+            write(pInterface->m_Channel.Data, &c, 1);
+        ++m_Events;
+    }
+
+    void OnLoop()
+    {
+        ++m_Loops;
+
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        if((uint64_t)tv.tv_sec * 1000000 + tv.tv_usec >= m_Deadline)
+            m_Scheduler.Quit();
+    }
+
+    EventScheduler& m_Scheduler;
+    uint64_t m_Deadline;
+    uint64_t m_Events;
+    uint64_t m_Loops;
+};
+
+double RunBench(int pairs, int seconds, int maxEvents, uint64_t* pLoops)
+{
+    EventScheduler scheduler;
+    if(scheduler.CreateScheduler(maxEvents) == -1)
+    {
+        printf("error: create scheduler fail, %s\n", safe_strerror(errno));
+        return 0;
+    }
+
+    timeval start;
+    gettimeofday(&start, NULL);
+    uint64_t begin = (uint64_t)start.tv_sec * 1000000 + start.tv_usec;
+
+    EventBench bench(scheduler, begin + (uint64_t)seconds * 1000000);
+    scheduler.RegisterLoopCallback(boost::bind(&EventBench::OnLoop, &bench));
+
+    std::vector<ServerInterface<int>*> vInterface;
+    for(int i = 0; i < pairs; ++i)
+    {
+        int sv[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1)
+        {
+            printf("error: socketpair fail, %s\n", safe_strerror(errno));
+            break;
+        }
+
+        ServerInterface<int>* pInterface = new ServerInterface<int>();
+        pInterface->m_Channel.Socket = sv[0];
+        pInterface->m_Channel.Data = sv[1];
+        pInterface->m_ReadableCallback = boost::bind(&EventBench::OnReadable, &bench, _1);
+        scheduler.Register(pInterface, EventScheduler::PollType::IN);
+        vInterface.push_back(pInterface);
+
+        write(sv[1], "x", 1);
+    }
+
+    scheduler.Dispatch();
+
+    timeval end;
+    gettimeofday(&end, NULL);
+    double span = CLOCK_COMPUTE_TIMESPAN(start, end) / 1000;
+
+    for(std::vector<ServerInterface<int>*>::iterator iter = vInterface.begin();
+        iter != vInterface.end();
+        ++iter)
+    {
+        scheduler.UnRegister(*iter);
+        close((*iter)->m_Channel.Socket);
+        close((*iter)->m_Channel.Data);
+        delete *iter;
+    }
+    scheduler.Close();
+
+    *pLoops = bench.m_Loops;
+    return bench.m_Events / span;
+}
+
+int main(int argc, char* argv[])
+{
+    int pairs = 1000;
+    int seconds = 3;
+    int maxEvents = EPOLL_DEFAULT_MAXEVENTS;
+
+    if(argc > 1)
+        pairs = atoi(argv[1]);
+    if(argc > 2)
+        seconds = atoi(argv[2]);
+    if(argc > 3)
+        maxEvents = atoi(argv[3]);
+
+    uint64_t loops = 0;
+    double single = RunBench(pairs, seconds, 1, &loops);
+    printf("max_events: %-5d %12.0f events/s  %10lu loops\n", 1, single, loops);
+
+    double batch = RunBench(pairs, seconds, maxEvents, &loops);
+    printf("max_events: %-5d %12.0f events/s  %10lu loops\n", maxEvents, batch, loops);
+
+    if(single > 0)
+        printf("speedup: %.02fx\n", batch / single);
+    return 0;
+}
+
@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <boost/format.hpp>
+#include <vector>
+#include "PoolObject.hpp"
+#include "Clock.hpp"
+#include "Log.hpp"
+#include "EventScheduler.hpp"
+#include "UdpServer.hpp"
+
+//
+// gsobench [seconds] [segment size] [segments per send]
+//   loopback udp bulk send, every send is a buffer of same sized segments
+//   with a shorter last one. runs with one sendto per segment, with
+//   UDP_SEGMENT, and with UDP_SEGMENT into a UDP_GRO receiver. the receiver
+//   checks that every segment it gets has the size of its place in the buffer.
+//
+class GsoSink :
+    public UdpServer<GsoSink>
+{
+public:
+    GsoSink(size_t segment, size_t size) :
+        m_SegmentSize(segment),
+        m_BufferSize(size),
+        m_Bytes(0),
+        m_Bad(0)
+    {
+    }
+
+    void OnMessage(ChannelType& channel, IOBuffer& in)
+    {
+        uint32_t idx = 0;
+        if(in.GetReadSize() < sizeof(uint32_t) || in.Read((char*)&idx, sizeof(uint32_t)) == 0)
+        {
+            ++m_Bad;
+            return;
+        }
+
+        idx = ntohl(idx);
+        size_t offset = idx * m_SegmentSize;
+        size_t expect = (m_BufferSize - offset < m_SegmentSize) ? m_BufferSize - offset : m_SegmentSize;
+        if(offset >= m_BufferSize || in.GetReadSize() != expect)
+            ++m_Bad;
+
+        m_Bytes += in.GetReadSize();
+    }
+
+    size_t m_SegmentSize;
+    size_t m_BufferSize;
+    uint64_t m_Bytes;
+    uint64_t m_Bad;
+};
+
+class GsoSender :
+    public UdpServer<GsoSender>
+{
+public:
+    void OnMessage(ChannelType& channel, IOBuffer& in)
+    {
+    }
+};
+
+struct BenchLoop
+{
+    GsoSender* pSender;
+    sockaddr_in Target;
+    std::vector<char> Buffer;
+    size_t SegmentSize;
+    bool bGso;
+    uint64_t Deadline;
+
+    void OnLoop()
+    {
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        if((uint64_t)tv.tv_sec * 1000000 + tv.tv_usec >= Deadline)
+        {
+            PoolObject<EventScheduler>::Instance().Quit();
+            return;
+        }
+
+        if(!pSender)
+            return;
+
+        // a few buffers per iteration, the receiver reads between them.
+        for(int i = 0; i < 4; ++i)
+        {
+            if(bGso)
+            {
+                pSender->SendSegments(&Buffer[0], Buffer.size(), SegmentSize, Target);
+                continue;
+            }
+
+            for(size_t offset = 0; offset < Buffer.size(); offset += SegmentSize)
+            {
+                size_t size = (Buffer.size() - offset < SegmentSize) ? Buffer.size() - offset : SegmentSize;
+                pSender->Send(&Buffer[offset], size, Target);
+            }
+        }
+    }
+};
+
+void RunBench(BenchLoop& loop, const char* name, int seconds, bool gso, bool gro)
+{
+    EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
+    if(scheduler.CreateScheduler(EPOLL_DEFAULT_MAXEVENTS) == -1)
+    {
+        printf("error: create scheduler fail, %s\n", safe_strerror(errno));
+        return;
+    }
+    scheduler.SetIdleTimeout(0);
+
+    GsoSink* pSink = new GsoSink(loop.SegmentSize, loop.Buffer.size());
+    GsoSender* pSender = new GsoSender();
+
+    sockaddr_in addr;
+    bzero(&addr, sizeof(sockaddr_in));
+    addr.sin_family = PF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    socklen_t len = sizeof(sockaddr_in);
+
+    int rcvbuf = 16777216;
+    setsockopt(pSink->m_ServerInterface.m_Channel.Socket, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(int));
+
+    if(-1 == pSink->Listen(addr) ||
+       -1 == getsockname(pSink->m_ServerInterface.m_Channel.Socket, (sockaddr*)&addr, &len) ||
+       -1 == pSink->SetBatch(16) ||
+       -1 == scheduler.Register(pSink, EventScheduler::PollType::IN))
+    {
+        printf("error: listen fail, %s\n", safe_strerror(errno));
+        delete pSink;
+        delete pSender;
+        scheduler.Close();
+        return;
+    }
+
+    if(gro && pSink->SetGro(true) != 0)
+        printf("warning: no UDP_GRO, %s\n", safe_strerror(errno));
+
+    loop.pSender = pSender;
+    loop.Target = addr;
+    loop.bGso = gso;
+
+    timeval start;
+    gettimeofday(&start, NULL);
+    loop.Deadline = (uint64_t)start.tv_sec * 1000000 + start.tv_usec + (uint64_t)seconds * 1000000;
+
+    uint64_t begin = ReadCycleCounter();
+    scheduler.Dispatch();
+    uint64_t cycles = ReadCycleCounter() - begin;
+
+    timeval end;
+    gettimeofday(&end, NULL);
+    double span = CLOCK_COMPUTE_TIMESPAN(start, end) / 1000;
+
+    UdpServerStats& sent = pSender->GetStats();
+    UdpServerStats& recvd = pSink->GetStats();
+    printf("%-8s: %8.1f MB/s %10.0f seg/s %8llu cycles/seg, seg/write: %.1f, reads: %llu, coalesced: %llu, gso: %s, bad: %llu\n",
+            name,
+            pSink->m_Bytes / span / 1048576,
+            recvd.Messages / span,
+            (unsigned long long)(recvd.Messages ? cycles / recvd.Messages : 0),
+            sent.Writes ? (double)sent.Sends / sent.Writes : 0,
+            (unsigned long long)recvd.Reads,
+            (unsigned long long)recvd.Coalesced,
+            pSender->IsGsoEnabled() ? "yes" : "fallback",
+            (unsigned long long)pSink->m_Bad);
+
+    loop.pSender = NULL;
+    scheduler.UnRegister(pSink);
+    close(pSink->m_ServerInterface.m_Channel.Socket);
+    close(pSender->m_ServerInterface.m_Channel.Socket);
+    scheduler.Close();
+    delete pSink;
+    delete pSender;
+}
+
+int main(int argc, char* argv[])
+{
+    int seconds = 3;
+    size_t segment = 1400;
+    size_t count = 40;
+
+    if(argc > 1)
+        seconds = atoi(argv[1]);
+    if(argc > 2)
+        segment = strtoul(argv[2], NULL, 10);
+    if(argc > 3)
+        count = strtoul(argv[3], NULL, 10);
+
+    if(segment < sizeof(uint32_t) || segment > 8192 || count < 1 || count > 256)
+    {
+        printf("usage: %s [seconds] [segment size 4-8192] [segments per send 1-256]\n", argv[0]);
+        return -1;
+    }
+
+    // the last segment is half size, every segment starts with its index.
+    BenchLoop loop;
+    loop.pSender = NULL;
+    loop.SegmentSize = segment;
+    loop.Buffer.assign(segment * count - segment / 2, 'x');
+    for(size_t i = 0; i < count; ++i)
+    {
+        uint32_t idx = htonl(i);
+        memcpy(&loop.Buffer[i * segment], &idx, sizeof(uint32_t));
+    }
+    loop.Deadline = 0;
+    PoolObject<EventScheduler>::Instance().RegisterLoopCallback(boost::bind(&BenchLoop::OnLoop, &loop));
+
+    RunBench(loop, "sendto", seconds, false, false);
+    RunBench(loop, "gso", seconds, true, false);
+    RunBench(loop, "gso+gro", seconds, true, true);
+    return 0;
+}
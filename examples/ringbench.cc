@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <boost/format.hpp>
+#include <string>
+#include <algorithm>
+#include "PoolObject.hpp"
+#include "Clock.hpp"
+#include "Log.hpp"
+#include "EventScheduler.hpp"
+#include "TcpServer.hpp"
+
+//
+// ringbench [seconds] [message size] [segment size] [segments per loop]
+//   loopback tcp framing, 4 byte length + body. the client writes the
+//   messages as one stream in segments that cross message boundaries, 16 per
+//   loop iteration by default, the server frames them out of the receive
+//   cache. runs once with an inline cache and once with the pooled cache.
+//   then the same stream is framed in memory without sockets, once by
+//   compaction like TcpServer and once by a ring that never moves the bytes
+//   but a frame across its end.
+//
+struct RingBenchStats
+{
+    uint64_t Messages;
+    uint64_t Bytes;
+    uint64_t Errors;
+
+    // frame the complete messages of in.
+    void Frame(IOBuffer& in)
+    {
+        while(true)
+        {
+            size_t dwLeftSize = in.GetReadSize() - in.GetReadPosition();
+
+            uint32_t len = 0;
+            if(dwLeftSize < sizeof(uint32_t) ||
+               in.Read((char*)&len, sizeof(uint32_t), in.GetReadPosition()) == 0)
+                return;
+
+            len = ntohl(len);
+            if(dwLeftSize < sizeof(uint32_t) + len)
+                return;
+
+            // the last byte of the body is the low byte of the length.
+            if((unsigned char)in.GetReadBuffer()[sizeof(uint32_t) + len - 1] != (len & 0xFF))
+                ++Errors;
+
+            in.ReadSeek(sizeof(uint32_t) + len);
+            ++Messages;
+            Bytes += len;
+        }
+    }
+};
+
+template<uint32_t CacheSize>
+class RingBench :
+    public TcpServer<RingBench<CacheSize>, void, CacheSize>
+{
+public:
+    typedef typename TcpServer<RingBench<CacheSize>, void, CacheSize>::ChannelType ChannelType;
+
+    RingBench()
+    {
+        bzero(&m_Stats, sizeof(RingBenchStats));
+    }
+
+    void OnMessage(ChannelType& channel, IOBuffer& in)
+    {
+        m_Stats.Frame(in);
+    }
+
+    RingBenchStats m_Stats;
+};
+
+// the stream of whole messages held twice, a segment from any offset of
+// the first copy ends in the second one. returns the size of one copy.
+size_t BuildStream(std::string& strStream, size_t size, size_t segment)
+{
+    std::string strMessage(sizeof(uint32_t) + size, 'x');
+    strMessage[strMessage.size() - 1] = (char)(size & 0xFF);
+
+    uint32_t dwLength = htonl(size);
+    memcpy(&strMessage[0], &dwLength, sizeof(uint32_t));
+
+    strStream.clear();
+    while(strStream.size() < segment)
+        strStream.append(strMessage);
+
+    size_t streamSize = strStream.size();
+    strStream.append(strStream);
+    return streamSize;
+}
+
+// the framing of TcpServer, the unread tail is moved to the front.
+void FrameCompact(char* cache, uint32_t size, uint32_t& availSize, const char* data, uint32_t dataSize, RingBenchStats& stats)
+{
+    TcpRecvCache::Append(cache, size, availSize, data, dataSize);
+
+    IOBuffer in(cache, availSize, availSize);
+    stats.Frame(in);
+    TcpRecvCache::Consume(cache, availSize, in.GetReadPosition());
+}
+
+// a ring, the bytes are framed where they are. the frame across the end is
+// moved to the front in one piece with the bytes after it.
+void FrameRing(char* cache, uint32_t size, uint32_t& readPos, uint32_t& availSize,
+               const char* data, uint32_t dataSize, RingBenchStats& stats)
+{
+    uint32_t copySize = (dataSize < size - availSize) ? dataSize : size - availSize;
+    uint32_t writePos = (readPos + availSize) % size;
+    uint32_t firstSize = (copySize < size - writePos) ? copySize : size - writePos;
+    memcpy(&cache[writePos], data, firstSize);
+    memcpy(cache, &data[firstSize], copySize - firstSize);
+    availSize += copySize;
+
+    while(true)
+    {
+        bool bWrapped = (readPos + availSize > size);
+        uint32_t dwReadSize = bWrapped ? size - readPos : availSize;
+
+        IOBuffer in(&cache[readPos], dwReadSize, dwReadSize);
+        stats.Frame(in);
+
+        availSize -= in.GetReadPosition();
+        readPos = (availSize == 0) ? 0 : (readPos + in.GetReadPosition()) % size;
+        if(!bWrapped || readPos + availSize <= size)
+            return;
+
+        uint32_t dwFirstSize = size - readPos;
+        uint32_t dwSecondSize = availSize - dwFirstSize;
+        memmove(&cache[dwSecondSize], &cache[readPos], dwFirstSize);
+        std::rotate(cache, &cache[dwSecondSize], &cache[availSize]);
+        readPos = 0;
+    }
+}
+
+// frame the stream from memory in reads of readSize for the given seconds.
+void MeasureMemory(const char* name, bool ring, int seconds, size_t size, size_t segment, uint32_t readSize)
+{
+    const uint32_t dwCacheSize = 8388608;
+
+    std::string strStream;
+    size_t streamSize = BuildStream(strStream, size, (readSize > segment) ? readSize : segment);
+
+    char* pCache = (char*)malloc(dwCacheSize);
+    uint32_t dwReadPos = 0;
+    uint32_t dwAvailSize = 0;
+    size_t offset = 0;
+
+    RingBenchStats stats;
+    bzero(&stats, sizeof(RingBenchStats));
+
+    timeval start;
+    gettimeofday(&start, NULL);
+    uint64_t deadline = (uint64_t)start.tv_sec * 1000000 + start.tv_usec + (uint64_t)seconds * 1000000;
+
+    uint64_t begin = ReadCycleCounter();
+    for(uint32_t i = 1; ; ++i)
+    {
+        if((i & 0xFF) == 0)
+        {
+            timeval tv;
+            gettimeofday(&tv, NULL);
+            if((uint64_t)tv.tv_sec * 1000000 + tv.tv_usec >= deadline)
+                break;
+        }
+
+        if(ring)
+            FrameRing(pCache, dwCacheSize, dwReadPos, dwAvailSize, &strStream[offset], readSize, stats);
+        else
+            FrameCompact(pCache, dwCacheSize, dwAvailSize, &strStream[offset], readSize, stats);
+
+        offset += readSize;
+        if(offset >= streamSize)
+            offset -= streamSize;
+    }
+    uint64_t cycles = ReadCycleCounter() - begin;
+
+    timeval end;
+    gettimeofday(&end, NULL);
+    double span = CLOCK_COMPUTE_TIMESPAN(start, end) / 1000;
+
+    printf("%-8s: %10.1f MB/s %10.1f msg/s %12llu cycles/msg, errors: %llu\n",
+            name,
+            stats.Bytes / span / 1048576,
+            stats.Messages / span,
+            (unsigned long long)(stats.Messages ? cycles / stats.Messages : 0),
+            (unsigned long long)stats.Errors);
+    free(pCache);
+}
+
+struct RingBenchClient
+{
+    int Socket;
+    uint64_t Deadline;
+    std::string Stream;         // whole messages, held twice
+    size_t StreamSize;
+    size_t Offset;
+    size_t SegmentSize;
+    int Segments;
+
+    void OnLoop()
+    {
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        if((uint64_t)tv.tv_sec * 1000000 + tv.tv_usec >= Deadline)
+        {
+            PoolObject<EventScheduler>::Instance().Quit();
+            return;
+        }
+
+        // a few segments per iteration, the server reads between them.
+        for(int i = 0; i < Segments; ++i)
+        {
+            // segments run across message boundaries like a real stream.
+            ssize_t sendSize = send(Socket, &Stream[Offset], SegmentSize, MSG_DONTWAIT);
+            if(sendSize <= 0)
+                return;
+
+            Offset += sendSize;
+            if(Offset >= StreamSize)
+                Offset -= StreamSize;
+        }
+    }
+};
+
+// connect the client to addr and run the scheduler until its deadline.
+void Measure(RingBenchClient& client, sockaddr_in& addr, const char* name,
+             int seconds, size_t size, size_t segment, RingBenchStats& stats)
+{
+    EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
+
+    timeval start;
+    gettimeofday(&start, NULL);
+
+    client.Socket = socket(PF_INET, SOCK_STREAM|SOCK_CLOEXEC, 0);
+    client.Deadline = (uint64_t)start.tv_sec * 1000000 + start.tv_usec + (uint64_t)seconds * 1000000;
+    client.StreamSize = BuildStream(client.Stream, size, segment);
+    client.Offset = 0;
+    client.SegmentSize = segment;
+
+    if(-1 == connect(client.Socket, (sockaddr*)&addr, sizeof(sockaddr_in)))
+    {
+        printf("error: connect fail, %s\n", safe_strerror(errno));
+        close(client.Socket);
+        return;
+    }
+
+    int nodelay = 1;
+    setsockopt(client.Socket, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(int));
+
+    uint64_t begin = ReadCycleCounter();
+    scheduler.Dispatch();
+    uint64_t cycles = ReadCycleCounter() - begin;
+
+    timeval end;
+    gettimeofday(&end, NULL);
+    double span = CLOCK_COMPUTE_TIMESPAN(start, end) / 1000;
+
+    printf("%-8s: %10.1f MB/s %10.1f msg/s %12llu cycles/msg, errors: %llu\n",
+            name,
+            stats.Bytes / span / 1048576,
+            stats.Messages / span,
+            (unsigned long long)(stats.Messages ? cycles / stats.Messages : 0),
+            (unsigned long long)stats.Errors);
+
+    close(client.Socket);
+}
+
+template<uint32_t CacheSize>
+void RunBench(RingBenchClient& client, const char* name, int seconds, size_t size, size_t segment)
+{
+    EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
+    if(scheduler.CreateScheduler(EPOLL_DEFAULT_MAXEVENTS) == -1)
+    {
+        printf("error: create scheduler fail, %s\n", safe_strerror(errno));
+        return;
+    }
+    scheduler.SetIdleTimeout(0);
+
+    RingBench<CacheSize>* pBench = new RingBench<CacheSize>();
+
+    sockaddr_in addr;
+    bzero(&addr, sizeof(sockaddr_in));
+    addr.sin_family = PF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    socklen_t len = sizeof(sockaddr_in);
+
+    if(-1 == pBench->Listen(addr) ||
+       -1 == getsockname(pBench->m_ServerInterface.m_Channel.Socket, (sockaddr*)&addr, &len) ||
+       -1 == scheduler.Register(pBench, EventScheduler::PollType::IN))
+    {
+        printf("error: listen fail, %s\n", safe_strerror(errno));
+        delete pBench;
+        scheduler.Close();
+        return;
+    }
+
+    Measure(client, addr, name, seconds, size, segment, pBench->m_Stats);
+
+    scheduler.UnRegister(pBench);
+    close(pBench->m_ServerInterface.m_Channel.Socket);
+    scheduler.Close();
+    delete pBench;
+}
+
+int main(int argc, char* argv[])
+{
+    int seconds = 3;
+    size_t size = 1048576;
+    size_t segment = 1024;
+    int segments = 16;
+
+    if(argc > 1)
+        seconds = atoi(argv[1]);
+    if(argc > 2)
+        size = strtoul(argv[2], NULL, 10);
+    if(argc > 3)
+        segment = strtoul(argv[3], NULL, 10);
+    if(argc > 4)
+        segments = atoi(argv[4]);
+
+    if(size < 1 || size > 4194304 || segment == 0 || segments < 1)
+    {
+        printf("usage: %s [seconds] [message size 1-4194304] [segment size] [segments per loop]\n", argv[0]);
+        return -1;
+    }
+
+    // all runs share the worker scheduler, the client loop callback is
+    // registered once.
+    RingBenchClient client;
+    client.Deadline = 0;
+    client.Segments = segments;
+    PoolObject<EventScheduler>::Instance().RegisterLoopCallback(boost::bind(&RingBenchClient::OnLoop, &client));
+
+    RunBench<8388608>(client, "inline", seconds, size, segment);
+    RunBench<0>(client, "pooled", seconds, size, segment);
+
+    // about what one read of the socket runs takes.
+    uint32_t readSize = (segment * segments < 8388608) ? segment * segments : 8388608;
+    MeasureMemory("compact", false, seconds, size, segment, readSize);
+    MeasureMemory("ring", true, seconds, size, segment, readSize);
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <boost/format.hpp>
+#include "PoolObject.hpp"
+#include "ObjectPool.hpp"
+#include "Log.hpp"
+#include "TcpServer.hpp"
+
+//
+// slotcheck
+//   the interface of a closed connection goes back to the ObjectPool and is
+//   handed to the next one. checks that the channel data of the recycled
+//   slot starts zeroed, with the inline and the pooled cache.
+//
+struct SessionData
+{
+    uint32_t dwUin;
+    uint64_t ddwSeq;
+    char szName[32];
+};
+
+template<uint32_t CacheSize>
+bool CheckSlot(const char* name)
+{
+    typedef ServerInterface<TcpChannelCache<SessionData, CacheSize> > InterfaceType;
+    ObjectPool<InterfaceType>& pool = PoolObject<ObjectPool<InterfaceType> >::Instance();
+
+    // the data of the last connection, volatile so that the stores are not
+    // dropped as dead before Free.
+    InterfaceType* pInterface = pool.Alloc();
+    volatile char* pData = (volatile char*)static_cast<SessionData*>(&pInterface->m_Channel.Data);
+    for(size_t i = 0; i < sizeof(SessionData); ++i)
+        pData[i] = 'x';
+    pool.Free(pInterface);
+
+    InterfaceType* pRecycled = pool.Alloc();
+    SessionData zero;
+    bzero(&zero, sizeof(SessionData));
+
+    bool ok = (pRecycled == pInterface &&
+               memcmp(static_cast<SessionData*>(&pRecycled->m_Channel.Data), &zero, sizeof(SessionData)) == 0);
+    printf("%-8s: %s\n", name, (pRecycled != pInterface) ? "slot not recycled" : (ok ? "ok" : "stale data"));
+
+    pool.Free(pRecycled);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    bool ok = CheckSlot<4096>("inline");
+    ok = CheckSlot<0>("pooled") && ok;
+    return ok ? 0 : -1;
+}
@@ -40,12 +40,14 @@ class MyTcpClient :
 public:
     void OnMessage(ChannelType& channel, IOBuffer& in)
     {
-        LOG("[PID:%u][%s:%d] server message: %s", 
+        // the message is not null terminated.
+        size_t size = in.GetReadSize() - in.GetReadPosition();
+        LOG("[PID:%u][%s:%d] server message: %.*s", 
                 Pool::Instance().GetID(),
                 inet_ntoa(channel.Address.sin_addr),
-                ntohs(channel.Address.sin_port), in.GetReadBuffer());
+                ntohs(channel.Address.sin_port), (int)size, in.GetReadBuffer());
 
-        in.ReadSeek(in.GetReadSize());
+        in.ReadSeek(size);
 
         PoolObject<ConnectionPool<MyTcpClient> >::Instance().Detach(this);
     }
@@ -56,6 +58,8 @@ public:
                 Pool::Instance().GetID(),
                 inet_ntoa(channel.Address.sin_addr),
                 ntohs(channel.Address.sin_port));
+
+        PoolObject<ConnectionPool<MyTcpClient> >::Instance().Detach(this);
     }
 
     void OnConnected(ChannelType& channel)
@@ -113,26 +117,18 @@ public:
         addr.sin_port = htons(atoi(stClientConfig["port"].c_str()));
         addr.sin_addr.s_addr = inet_addr(stClientConfig["ip"].c_str());
 
+        // a new connection sends from OnConnected.
         MyTcpClient* pClient = NULL;
         ConnectionPool<MyTcpClient>& stPool = PoolObject<ConnectionPool<MyTcpClient> >::Instance();
-        if(0 != stPool.Attach(addr, &pClient) || pClient == NULL)
+        int iRet = stPool.AsyncAttach(addr, &pClient);
+        if(iRet == -1)
         {
             fprintf(stderr, "error: attach connection fail.\n");
             return;
         }
 
-        if(!pClient->IsConnected())
-        {
-            timeval tv;
-            tv.tv_sec = 0;
-            tv.tv_usec = 100000;
-
-            if(0 != pClient->Connect(addr, &tv))
-            {
-                fprintf(stderr, "error: connect server fail.\n");
-            }
+        if(iRet == 0)
             return;
-        }
 
         pClient->SendRequest();
     }
@@ -40,20 +40,22 @@ class TcpService :
 public:
     void OnMessage(ChannelType& channel, IOBuffer& in)
     {
-        TRACE_LOG("[PID:%u][%s:%d] client message: %s", 
+        // the message is not null terminated.
+        size_t size = in.GetReadSize() - in.GetReadPosition();
+        TRACE_LOG("[PID:%u][%s:%d] client message: %.*s", 
                   Pool::Instance().GetID(),
                   inet_ntoa(channel.Address.sin_addr),
                   ntohs(channel.Address.sin_port), 
-                  in.GetReadBuffer());
+                  (int)size, in.GetReadBuffer());
 
         char buffer[4096];
         IOBuffer out(buffer, 4096);
         out.Write("resp => ", 8);
-        out.Write(in.GetReadBuffer(), in.GetReadSize());
+        out.Write(in.GetReadBuffer(), size);
         
-        channel << out;
+        this->Send(channel, out);
 
-        in.ReadSeek(in.GetReadSize());
+        in.ReadSeek(size);
     }
 
     void OnConnected(ChannelType& channel)
@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <boost/format.hpp>
+#include <vector>
+#include "PoolObject.hpp"
+#include "Clock.hpp"
+#include "Log.hpp"
+#include "EventScheduler.hpp"
+#include "UdpServer.hpp"
+
+//
+// udpbench [seconds] [batch size] [message size]
+//   loopback udp echo. a generator thread floods the server with sendmmsg and
+//   drains the echos, the server runs once with a recvmsg and sendto per
+//   datagram and once with recvmmsg and sendmmsg batches.
+//
+class UdpBench :
+    public UdpServer<UdpBench>
+{
+public:
+    void OnMessage(ChannelType& channel, IOBuffer& in)
+    {
+        this->Send(in.GetReadBuffer(), in.GetReadSize(), channel.Address);
+    }
+};
+
+struct Generator
+{
+    int Socket;
+    sockaddr_in Target;
+    size_t MessageSize;
+    volatile bool bStop;
+    uint64_t Sent;
+    uint64_t Echos;
+
+    static void* Run(void* pArg)
+    {
+        Generator* pGenerator = (Generator*)pArg;
+
+        std::vector<char> buffer(pGenerator->MessageSize, 'x');
+        std::vector<char> echo(65536 * 4);
+        mmsghdr msgs[64];
+        iovec iov[64];
+        bzero(msgs, sizeof(msgs));
+        for(int i = 0; i < 64; ++i)
+        {
+            iov[i].iov_base = &buffer[0];
+            iov[i].iov_len = buffer.size();
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &pGenerator->Target;
+            msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        }
+
+        while(!pGenerator->bStop)
+        {
+            int iRet = sendmmsg(pGenerator->Socket, msgs, 64, MSG_DONTWAIT);
+            if(iRet > 0)
+                pGenerator->Sent += iRet;
+
+            // the echos are only counted, one big recv buffer takes them all.
+            while(recv(pGenerator->Socket, &echo[0], echo.size(), MSG_DONTWAIT) > 0)
+                ++pGenerator->Echos;
+        }
+        return NULL;
+    }
+};
+
+struct BenchLoop
+{
+    uint64_t Deadline;
+
+    void OnLoop()
+    {
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        if((uint64_t)tv.tv_sec * 1000000 + tv.tv_usec >= Deadline)
+            PoolObject<EventScheduler>::Instance().Quit();
+    }
+};
+
+void RunBench(BenchLoop& loop, const char* name, int seconds, uint32_t batch, size_t size)
+{
+    EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
+    if(scheduler.CreateScheduler(EPOLL_DEFAULT_MAXEVENTS) == -1)
+    {
+        printf("error: create scheduler fail, %s\n", safe_strerror(errno));
+        return;
+    }
+    scheduler.SetIdleTimeout(1);
+
+    UdpBench* pBench = new UdpBench();
+
+    sockaddr_in addr;
+    bzero(&addr, sizeof(sockaddr_in));
+    addr.sin_family = PF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    socklen_t len = sizeof(sockaddr_in);
+
+    int rcvbuf = 8388608;
+    setsockopt(pBench->m_ServerInterface.m_Channel.Socket, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(int));
+
+    if(-1 == pBench->Listen(addr) ||
+       -1 == getsockname(pBench->m_ServerInterface.m_Channel.Socket, (sockaddr*)&addr, &len) ||
+       -1 == pBench->SetBatch(batch, 2048) ||
+       -1 == scheduler.Register(pBench, EventScheduler::PollType::IN))
+    {
+        printf("error: listen fail, %s\n", safe_strerror(errno));
+        delete pBench;
+        scheduler.Close();
+        return;
+    }
+
+    Generator generator;
+    generator.Socket = socket(PF_INET, SOCK_DGRAM|SOCK_CLOEXEC, 0);
+    generator.Target = addr;
+    generator.MessageSize = size;
+    generator.bStop = false;
+    generator.Sent = 0;
+    generator.Echos = 0;
+    setsockopt(generator.Socket, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(int));
+
+    timeval start;
+    gettimeofday(&start, NULL);
+    loop.Deadline = (uint64_t)start.tv_sec * 1000000 + start.tv_usec + (uint64_t)seconds * 1000000;
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, &Generator::Run, &generator);
+
+    uint64_t begin = ReadCycleCounter();
+    scheduler.Dispatch();
+    uint64_t cycles = ReadCycleCounter() - begin;
+
+    timeval end;
+    gettimeofday(&end, NULL);
+    double span = CLOCK_COMPUTE_TIMESPAN(start, end) / 1000;
+
+    generator.bStop = true;
+    pthread_join(thread, NULL);
+
+    UdpServerStats& stats = pBench->GetStats();
+    printf("%-8s: %10.0f pps %8llu cycles/msg, msg/read: %.1f, msg/write: %.1f, sent: %llu, echos: %llu, send errors: %llu\n",
+            name,
+            stats.Messages / span,
+            (unsigned long long)(stats.Messages ? cycles / stats.Messages : 0),
+            stats.Reads ? (double)stats.Messages / stats.Reads : 0,
+            stats.Writes ? (double)stats.Sends / stats.Writes : 0,
+            (unsigned long long)generator.Sent,
+            (unsigned long long)generator.Echos,
+            (unsigned long long)stats.SendErrors);
+
+    close(generator.Socket);
+    scheduler.UnRegister(pBench);
+    close(pBench->m_ServerInterface.m_Channel.Socket);
+    scheduler.Close();
+    delete pBench;
+}
+
+int main(int argc, char* argv[])
+{
+    int seconds = 3;
+    uint32_t batch = 64;
+    size_t size = 64;
+
+    if(argc > 1)
+        seconds = atoi(argv[1]);
+    if(argc > 2)
+        batch = strtoul(argv[2], NULL, 10);
+    if(argc > 3)
+        size = strtoul(argv[3], NULL, 10);
+
+    if(batch < 2 || size < 1 || size > 2048)
+    {
+        printf("usage: %s [seconds] [batch size 2-1024] [message size 1-2048]\n", argv[0]);
+        return -1;
+    }
+
+    BenchLoop loop;
+    loop.Deadline = 0;
+    PoolObject<EventScheduler>::Instance().RegisterLoopCallback(boost::bind(&BenchLoop::OnLoop, &loop));
+
+    RunBench(loop, "single", seconds, 0, size);
+    RunBench(loop, "batch", seconds, batch, size);
+    return 0;
+}
@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <boost/format.hpp>
+#include <vector>
+#include "PoolObject.hpp"
+#include "Clock.hpp"
+#include "Log.hpp"
+#include "EventScheduler.hpp"
+#include "UdpServer.hpp"
+#include "UdpClient.hpp"
+
+//
+// udpclientbench [seconds] [requests in flight] [drop every n]
+//   loopback udp request and response. the client keeps a number of requests
+//   in flight and sends the next one from the callback of the last, an echo
+//   server drops every n-th datagram so that requests are retransmitted.
+//
+class EchoServer :
+    public UdpServer<EchoServer>
+{
+public:
+    EchoServer(uint32_t drop) :
+        m_dwDrop(drop),
+        m_dwCount(0)
+    {
+    }
+
+    void OnMessage(ChannelType& channel, IOBuffer& in)
+    {
+        if(m_dwDrop && ++m_dwCount % m_dwDrop == 0)
+            return;
+
+        this->Send(in.GetReadBuffer(), in.GetReadSize(), channel.Address);
+    }
+
+    uint32_t m_dwDrop;
+    uint32_t m_dwCount;
+};
+
+class BenchClient :
+    public UdpClient<BenchClient>
+{
+public:
+    BenchClient() :
+        m_bStop(false),
+        m_Responses(0),
+        m_Failures(0),
+        m_Bad(0)
+    {
+        bzero(&m_Target, sizeof(sockaddr_in));
+    }
+
+    void Next()
+    {
+        if(m_bStop)
+            return;
+
+        char buffer[64];
+        int len = snprintf(buffer, sizeof(buffer), "request %llu", (unsigned long long)(m_Responses + m_Failures));
+        if(0 == this->Request(m_Target, buffer, len, boost::bind(&BenchClient::OnResponse, this, _1, _2)))
+            ++m_Failures;
+    }
+
+    void OnResponse(Token token, IOBuffer* pResponse)
+    {
+        if(!pResponse)
+            ++m_Failures;
+        else if(pResponse->GetReadSize() < 8 || memcmp(pResponse->GetReadBuffer(), "request ", 8) != 0)
+            ++m_Bad;
+        else
+            ++m_Responses;
+
+        Next();
+    }
+
+    sockaddr_in m_Target;
+    bool m_bStop;
+    uint64_t m_Responses;
+    uint64_t m_Failures;
+    uint64_t m_Bad;
+};
+
+struct BenchLoop
+{
+    uint64_t Deadline;
+
+    void OnLoop()
+    {
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        if((uint64_t)tv.tv_sec * 1000000 + tv.tv_usec >= Deadline)
+            PoolObject<EventScheduler>::Instance().Quit();
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    int seconds = 3;
+    uint32_t inflight = 256;
+    uint32_t drop = 100;
+
+    if(argc > 1)
+        seconds = atoi(argv[1]);
+    if(argc > 2)
+        inflight = strtoul(argv[2], NULL, 10);
+    if(argc > 3)
+        drop = strtoul(argv[3], NULL, 10);
+
+    if(inflight < 1 || inflight > UDPCLIENT_MAX_REQUESTS)
+    {
+        printf("usage: %s [seconds] [requests in flight 1-%d] [drop every n, 0 for none]\n", argv[0], UDPCLIENT_MAX_REQUESTS);
+        return -1;
+    }
+
+    EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
+    if(scheduler.CreateScheduler(EPOLL_DEFAULT_MAXEVENTS) == -1)
+    {
+        printf("error: create scheduler fail, %s\n", safe_strerror(errno));
+        return -1;
+    }
+
+    // no pool is started here, the timer of the requests is hooked up by hand.
+    PoolObject<Timer<UdpRequest*> >::Instance().Startup();
+
+    BenchLoop loop;
+    scheduler.RegisterLoopCallback(boost::bind(&BenchLoop::OnLoop, &loop));
+
+    EchoServer server(drop);
+    BenchClient client;
+
+    sockaddr_in addr;
+    bzero(&addr, sizeof(sockaddr_in));
+    addr.sin_family = PF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    socklen_t len = sizeof(sockaddr_in);
+
+    if(-1 == server.Listen(addr) ||
+       -1 == getsockname(server.m_ServerInterface.m_Channel.Socket, (sockaddr*)&addr, &len) ||
+       -1 == server.SetBatch(64) ||
+       -1 == scheduler.Register(&server, EventScheduler::PollType::IN) ||
+       -1 == client.Open())
+    {
+        printf("error: listen fail, %s\n", safe_strerror(errno));
+        return -1;
+    }
+    client.m_Target = addr;
+
+    timeval start;
+    gettimeofday(&start, NULL);
+    loop.Deadline = (uint64_t)start.tv_sec * 1000000 + start.tv_usec + (uint64_t)seconds * 1000000;
+
+    for(uint32_t i = 0; i < inflight; ++i)
+        client.Next();
+
+    uint64_t begin = ReadCycleCounter();
+    scheduler.Dispatch();
+    uint64_t cycles = ReadCycleCounter() - begin;
+
+    timeval end;
+    gettimeofday(&end, NULL);
+    double span = CLOCK_COMPUTE_TIMESPAN(start, end) / 1000;
+    client.m_bStop = true;
+
+    UdpClientStats& stats = client.GetStats();
+    printf("%10.0f req/s %8llu cycles/req, req/write: %.1f, resp/read: %.1f, retransmits: %llu, timeouts: %llu, stale: %llu, rejected: %llu, bad: %llu\n",
+            client.m_Responses / span,
+            (unsigned long long)(client.m_Responses ? cycles / client.m_Responses : 0),
+            stats.Writes ? (double)(stats.Requests + stats.Retransmits) / stats.Writes : 0,
+            stats.Reads ? (double)stats.Responses / stats.Reads : 0,
+            (unsigned long long)stats.Retransmits,
+            (unsigned long long)stats.Timeouts,
+            (unsigned long long)stats.Stale,
+            (unsigned long long)stats.Rejected,
+            (unsigned long long)client.m_Bad);
+
+    scheduler.UnRegister(&client);
+    scheduler.UnRegister(&server);
+    return 0;
+}
+
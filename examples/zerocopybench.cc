@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <boost/format.hpp>
+#include <string>
+#include "PoolObject.hpp"
+#include "Clock.hpp"
+#include "Log.hpp"
+#include "EventScheduler.hpp"
+#include "TcpServer.hpp"
+
+//
+// zerocopybench [seconds] [write size]
+//   loopback bulk transfer from the server to a sink that discards it. every
+//   zero copy path runs against its copy path:
+//     file:    pread + Send        vs SendFile
+//     buffer:  Send                vs SendZeroCopy
+//     socket:  recv + Send         vs Splice, from a second loopback feed
+//   MSG_ZEROCOPY on loopback is completed by a copy, the copied count shows it,
+//   run it against a remote sink for the real numbers.
+//
+enum BenchMode
+{
+    MODE_COPY_FILE,
+    MODE_SENDFILE,
+    MODE_COPY_BUFFER,
+    MODE_ZEROCOPY,
+    MODE_COPY_SOCKET,
+    MODE_SPLICE
+};
+
+const char* g_ModeNames[] = { "pread", "sendfile", "send", "zerocopy", "recv", "splice" };
+
+#define BENCH_FILE_SIZE         67108864
+#define BENCH_PENDING_SIZE      4194304
+#define BENCH_MAX_INFLIGHT      16
+
+class ZeroCopyBench :
+    public TcpServer<ZeroCopyBench>
+{
+public:
+    ZeroCopyBench(BenchMode mode, size_t size, int filefd, char* buffer) :
+        m_Mode(mode),
+        m_WriteSize(size),
+        m_FileFd(filefd),
+        m_Buffer(buffer),
+        m_pChannel(NULL),
+        m_Offset(0),
+        m_Inflight(0),
+        m_Errors(0)
+    {
+    }
+
+    void OnConnected(ChannelType& channel)
+    {
+        m_pChannel = &channel;
+    }
+
+    void OnDisconnected(ChannelType& channel)
+    {
+        m_pChannel = NULL;
+    }
+
+    void OnRelease()
+    {
+        --m_Inflight;
+    }
+
+    // keep the send queue of the sink connection filled.
+    void Pump()
+    {
+        if(!m_pChannel || m_Mode == MODE_COPY_SOCKET || m_Mode == MODE_SPLICE)
+            return;
+
+        while(this->GetPendingSize(*m_pChannel) < BENCH_PENDING_SIZE)
+        {
+            ssize_t iRet = 0;
+            switch(m_Mode)
+            {
+            case MODE_COPY_FILE:
+                iRet = pread(m_FileFd, m_Buffer, m_WriteSize, m_Offset);
+                if(iRet > 0)
+                    iRet = this->Send(*m_pChannel, m_Buffer, iRet);
+                break;
+            case MODE_SENDFILE:
+                iRet = this->SendFile(*m_pChannel, m_FileFd, m_Offset, m_WriteSize);
+                break;
+            case MODE_COPY_BUFFER:
+                iRet = this->Send(*m_pChannel, m_Buffer + m_Offset, m_WriteSize);
+                break;
+            case MODE_ZEROCOPY:
+                // the buffer is never written, the in-flight limit only
+                // bounds the pinned pages.
+                if(m_Inflight >= BENCH_MAX_INFLIGHT)
+                    return;
+                ++m_Inflight;
+                iRet = this->SendZeroCopy(*m_pChannel, m_Buffer + m_Offset, m_WriteSize,
+                                          boost::bind(&ZeroCopyBench::OnRelease, this));
+                break;
+            default:
+                return;
+            }
+
+            if(iRet <= 0 || !m_pChannel)
+            {
+                ++m_Errors;
+                return;
+            }
+
+            m_Offset += m_WriteSize;
+            if(m_Offset + m_WriteSize > BENCH_FILE_SIZE)
+                m_Offset = 0;
+        }
+    }
+
+    // bytes from the feed connection.
+    void OnFeed(ServerInterface<int>* pInterface)
+    {
+        if(!m_pChannel || this->GetPendingSize(*m_pChannel) >= BENCH_PENDING_SIZE)
+            return;
+
+        ssize_t iRet = 0;
+        if(m_Mode == MODE_SPLICE)
+            iRet = this->Splice(*m_pChannel, pInterface->m_Channel.Socket, m_WriteSize);
+        else
+        {
+            iRet = ChannelRecv(pInterface->m_Channel.Socket, m_Buffer, m_WriteSize);
+            if(iRet > 0 && this->Send(*m_pChannel, m_Buffer, iRet) == -1)
+                iRet = CHANNEL_ERROR;
+        }
+
+        if(iRet < 0 && iRet != CHANNEL_AGAIN)
+            ++m_Errors;
+    }
+
+    BenchMode m_Mode;
+    size_t m_WriteSize;
+    int m_FileFd;
+    char* m_Buffer;
+    ChannelType* m_pChannel;
+    size_t m_Offset;
+    uint32_t m_Inflight;
+    uint64_t m_Errors;
+};
+
+struct BenchLoop
+{
+    ZeroCopyBench* pBench;
+    ServerInterface<int>* pSink;
+    ServerInterface<int>* pFeed;
+    int FeedSocket;
+    char* Buffer;
+    size_t WriteSize;
+    uint64_t Deadline;
+    uint64_t Bytes;
+
+    void OnLoop()
+    {
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        if((uint64_t)tv.tv_sec * 1000000 + tv.tv_usec >= Deadline)
+        {
+            PoolObject<EventScheduler>::Instance().Quit();
+            return;
+        }
+
+        if(!pBench)
+            return;
+
+        pBench->Pump();
+
+        // the feed writes as fast as the splice or copy path drains it.
+        if(FeedSocket != -1)
+            send(FeedSocket, Buffer, WriteSize, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+
+    void OnSink(ServerInterface<int>* pInterface)
+    {
+        char buffer[262144];
+        ssize_t size = recv(pInterface->m_Channel.Socket, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if(size > 0)
+            Bytes += size;
+    }
+};
+
+int ConnectLoopback(sockaddr_in& addr)
+{
+    int fd = socket(PF_INET, SOCK_STREAM|SOCK_CLOEXEC, 0);
+    if(fd == -1)
+        return -1;
+
+    if(-1 == connect(fd, (sockaddr*)&addr, sizeof(sockaddr_in)))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+ServerInterface<int>* RegisterSocket(int fd, boost::function<void(ServerInterface<int>*)> callback)
+{
+    ServerInterface<int>* pInterface = new ServerInterface<int>();
+    pInterface->m_Channel.Socket = fd;
+    pInterface->m_Channel.Data = 0;
+    pInterface->m_ReadableCallback = callback;
+    PoolObject<EventScheduler>::Instance().Register(pInterface, EventScheduler::PollType::IN);
+    return pInterface;
+}
+
+void UnRegisterSocket(ServerInterface<int>* pInterface)
+{
+    if(!pInterface)
+        return;
+
+    PoolObject<EventScheduler>::Instance().UnRegister(pInterface);
+    close(pInterface->m_Channel.Socket);
+    delete pInterface;
+}
+
+void RunBench(BenchLoop& loop, BenchMode mode, int seconds, size_t size, int filefd)
+{
+    EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
+    if(scheduler.CreateScheduler(EPOLL_DEFAULT_MAXEVENTS) == -1)
+    {
+        printf("error: create scheduler fail, %s\n", safe_strerror(errno));
+        return;
+    }
+    scheduler.SetIdleTimeout(0);
+
+    ZeroCopyBench* pBench = new ZeroCopyBench(mode, size, filefd, loop.Buffer);
+
+    sockaddr_in addr;
+    bzero(&addr, sizeof(sockaddr_in));
+    addr.sin_family = PF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    socklen_t len = sizeof(sockaddr_in);
+
+    if(-1 == pBench->Listen(addr) ||
+       -1 == getsockname(pBench->m_ServerInterface.m_Channel.Socket, (sockaddr*)&addr, &len) ||
+       -1 == scheduler.Register(pBench, EventScheduler::PollType::IN))
+    {
+        printf("error: listen fail, %s\n", safe_strerror(errno));
+        delete pBench;
+        scheduler.Close();
+        return;
+    }
+
+    int sinkfd = ConnectLoopback(addr);
+    if(sinkfd == -1)
+    {
+        printf("error: connect fail, %s\n", safe_strerror(errno));
+        scheduler.Close();
+        return;
+    }
+
+    loop.pBench = pBench;
+    loop.pSink = RegisterSocket(sinkfd, boost::bind(&BenchLoop::OnSink, &loop, _1));
+    loop.pFeed = NULL;
+    loop.FeedSocket = -1;
+    loop.WriteSize = size;
+    loop.Bytes = 0;
+
+    if(mode == MODE_COPY_SOCKET || mode == MODE_SPLICE)
+    {
+        // a plain loopback pair, the accepted end is the splice source.
+        int listenfd = socket(PF_INET, SOCK_STREAM|SOCK_CLOEXEC, 0);
+        sockaddr_in feedAddr = addr;
+        feedAddr.sin_port = 0;
+        len = sizeof(sockaddr_in);
+        if(-1 == bind(listenfd, (sockaddr*)&feedAddr, sizeof(sockaddr_in)) ||
+           -1 == listen(listenfd, 1) ||
+           -1 == getsockname(listenfd, (sockaddr*)&feedAddr, &len) ||
+           -1 == (loop.FeedSocket = ConnectLoopback(feedAddr)))
+        {
+            printf("error: feed fail, %s\n", safe_strerror(errno));
+            close(listenfd);
+            return;
+        }
+
+        int feedfd = accept4(listenfd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        close(listenfd);
+        loop.pFeed = RegisterSocket(feedfd, boost::bind(&ZeroCopyBench::OnFeed, pBench, _1));
+    }
+
+    timeval start;
+    gettimeofday(&start, NULL);
+    loop.Deadline = (uint64_t)start.tv_sec * 1000000 + start.tv_usec + (uint64_t)seconds * 1000000;
+
+    uint64_t begin = ReadCycleCounter();
+    scheduler.Dispatch();
+    uint64_t cycles = ReadCycleCounter() - begin;
+
+    timeval end;
+    gettimeofday(&end, NULL);
+    double span = CLOCK_COMPUTE_TIMESPAN(start, end) / 1000;
+
+    TcpSendStats& stats = pBench->GetSendStats();
+    printf("%-9s: %10.1f MB/s %10.1f cycles/KB, writes: %llu, zerocopy: %llu, copied: %llu, errors: %llu\n",
+            g_ModeNames[mode],
+            loop.Bytes / span / 1048576,
+            loop.Bytes ? (double)cycles * 1024 / loop.Bytes : 0,
+            (unsigned long long)stats.Writes,
+            (unsigned long long)stats.ZeroCopyWrites,
+            (unsigned long long)stats.ZeroCopyCopied,
+            (unsigned long long)pBench->m_Errors);
+
+    loop.pBench = NULL;
+    if(loop.FeedSocket != -1)
+        close(loop.FeedSocket);
+    UnRegisterSocket(loop.pFeed);
+    UnRegisterSocket(loop.pSink);
+    if(pBench->m_pChannel)
+        pBench->DisconnectClient(*pBench->m_pChannel);
+    scheduler.UnRegister(pBench);
+    close(pBench->m_ServerInterface.m_Channel.Socket);
+    scheduler.Close();
+    delete pBench;
+}
+
+int main(int argc, char* argv[])
+{
+    int seconds = 3;
+    size_t size = 262144;
+
+    if(argc > 1)
+        seconds = atoi(argv[1]);
+    if(argc > 2)
+        size = strtoul(argv[2], NULL, 10);
+
+    if(size < 4096 || size > 4194304)
+    {
+        printf("usage: %s [seconds] [write size 4096-4194304]\n", argv[0]);
+        return -1;
+    }
+
+    // the file is read from the page cache, written once here.
+    char path[] = "/tmp/zerocopybench.XXXXXX";
+    int filefd = mkstemp(path);
+    if(filefd == -1)
+    {
+        printf("error: create file fail, %s\n", safe_strerror(errno));
+        return -1;
+    }
+    unlink(path);
+
+    char* buffer = (char*)malloc(BENCH_FILE_SIZE);
+    for(size_t i = 0; i < BENCH_FILE_SIZE; ++i)
+        buffer[i] = (char)i;
+    if(write(filefd, buffer, BENCH_FILE_SIZE) != BENCH_FILE_SIZE)
+    {
+        printf("error: write file fail, %s\n", safe_strerror(errno));
+        return -1;
+    }
+
+    BenchLoop loop;
+    loop.pBench = NULL;
+    loop.Buffer = buffer;
+    loop.Deadline = 0;
+    PoolObject<EventScheduler>::Instance().RegisterLoopCallback(boost::bind(&BenchLoop::OnLoop, &loop));
+
+    for(int mode = MODE_COPY_FILE; mode <= MODE_SPLICE; ++mode)
+        RunBench(loop, (BenchMode)mode, seconds, size, filefd);
+
+    close(filefd);
+    free(buffer);
+    return 0;
+}
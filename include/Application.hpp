@@ -21,7 +21,6 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/time.h>
-#include <sys/select.h>
 
 #include <utility>
 #include <string>
@@ -61,6 +60,21 @@ public:
         addr.sin_addr.s_addr = inet_addr(stServerInterface["ip"].c_str());
 
         static UdpServerStartup<ServerImplT, sockaddr_in> startup;
+        startup.SetEdgeTriggered(IsEdgeTriggered(stServerInterface), GetWakeupBudget(stServerInterface));
+
+        // batch_size = N reads N datagrams per recvmmsg and sends the replies with sendmmsg.
+        startup.SetBatch(GetBudget(stServerInterface, "batch_size", 0),
+                         GetBudget(stServerInterface, "batch_slot_size", UDPSERVER_BATCH_SLOT_SIZE));
+
+        // gro = 1 takes coalesced datagrams where the kernel has UDP_GRO.
+        startup.SetGro(stServerInterface["gro"] == "1");
+
+        // reuseport = 1, every worker binds port with SO_REUSEPORT instead of
+        // port + worker id, reuseport_cpu = 1 steers by the receiving cpu.
+        startup.SetReusePort(stServerInterface["reuseport"] == "1", stServerInterface["reuseport_cpu"] == "1");
+
+        // drop_counter = 1 counts kernel drops with SO_RXQ_OVFL, rcvbuf = bytes.
+        startup.SetRecvBuffer(stServerInterface["drop_counter"] == "1", GetBudget(stServerInterface, "rcvbuf", 0));
         startup.Register(addr);
         return true;
     }
@@ -78,9 +92,40 @@ public:
         addr.sin_port = htons(atoi(stServerInterface["port"].c_str()));
         addr.sin_addr.s_addr = inet_addr(stServerInterface["ip"].c_str());
 
-        if(server.Listen(addr) != 0)
+        if(IsEdgeTriggered(stServerInterface) && 
+           server.SetEdgeTriggered(true, GetWakeupBudget(stServerInterface)) != 0)
             return false;
 
+        server.SetWakeupBudget(GetWakeupBudget(stServerInterface),
+                               GetBudget(stServerInterface, "byte_budget", SERVER_BYTE_BUDGET),
+                               GetBudget(stServerInterface, "accept_budget", SERVER_WAKEUP_BUDGET));
+        server.SetSendWatermark(GetBudget(stServerInterface, "send_high_watermark", SERVER_SEND_HIGH_WATERMARK),
+                                GetBudget(stServerInterface, "send_low_watermark", SERVER_SEND_LOW_WATERMARK));
+
+        // pooled receive buffers (CacheSize = 0) grow up to max_buffer_size.
+        server.SetMaxBufferSize(GetBudget(stServerInterface, "max_buffer_size", SERVER_MAX_BUFFER_SIZE));
+
+        // deferred_flush = 1 writes the replies of an iteration once, tcp_cork = 1 corks that write.
+        server.SetDeferredFlush(stServerInterface["deferred_flush"] == "1", stServerInterface["tcp_cork"] == "1");
+
+        // reuseport = 1, every worker opens its own listener at startup.
+        // otherwise exclusive = 1 registers the shared listener with EPOLLEXCLUSIVE,
+        // or acceptor = 1 (thread pool) accepts in one thread for all workers.
+        if(stServerInterface["reuseport"] == "1")
+            server.SetReusePort(true, stServerInterface["reuseport_cpu"] == "1");
+        else
+        {
+            if(stServerInterface["exclusive"] == "1" && server.SetExclusive(true) != 0)
+                return false;
+
+#if defined(POOL_USE_THREADPOOL)
+            server.SetAcceptor(stServerInterface["acceptor"] == "1");
+#endif
+
+            if(server.Listen(addr) != 0)
+                return false;
+        }
+
         static TcpServerStartup<ServerImplT, sockaddr_in> startup;
         startup.Register(&server, addr);
         return true;
@@ -100,10 +145,15 @@ public:
         addr.sin_addr.s_addr = inet_addr(stClientInterface["ip"].c_str());
 
         static TcpClientStartup<ClientImplT, sockaddr_in> startup;
+        startup.SetEdgeTriggered(IsEdgeTriggered(stClientInterface), GetWakeupBudget(stClientInterface));
+        startup.SetConnectTimeout(GetBudget(stClientInterface, "connect_timeout", TCPCLIENT_CONNECT_TIMEOUT));
         startup.Register(addr);
         return true;
     }
 
+    // start the connect with a timeout of timeout milliseconds, 0 for the
+    // connect timeout of the client. true if it is in progress or done, the
+    // client sends from OnConnected, OnConnectTimout tells the failure.
     template<typename ClientImplT>
     bool ConnectToServer(ClientImplT& client, const char* szConfigName, int timeout = 0)
     {
@@ -115,26 +165,29 @@ public:
         addr.sin_port = htons(atoi(stClientInterface["port"].c_str()));
         addr.sin_addr.s_addr = inet_addr(stClientInterface["ip"].c_str());
 
-        if(client.Connect(addr) != 0)
-            return false;
-
-        if(timeout == 0)
-            return true;
+        if(timeout > 0)
+            client.SetConnectTimeout(timeout);
 
-        int fd = client.m_ServerInterface.m_Channel.Socket;
+        return (client.AsyncConnect(addr) == 0);
+    }
 
-        fd_set writefds;
-        FD_ZERO(&writefds);
-        FD_SET(fd, &writefds);
+    // edge_triggered = 1 and wakeup_budget = N in the interface section.
+    static bool IsEdgeTriggered(std::map<std::string, std::string>& stInterface)
+    {
+        return (stInterface["edge_triggered"] == "1");
+    }
 
-        timeval tv;
-        bzero(&tv, sizeof(timeval));
-        tv.tv_usec = 1000 * timeout; // 100 millisec timeout
+    static uint32_t GetWakeupBudget(std::map<std::string, std::string>& stInterface)
+    {
+        return GetBudget(stInterface, "wakeup_budget", SERVER_WAKEUP_BUDGET);
+    }
 
-        int ready = select(fd + 1, NULL, &writefds, NULL, &tv);
-        if(ready == -1 || !FD_ISSET(fd, &writefds))
-            return false;
-        return true;
+    // byte_budget, accept_budget and the send watermarks of tcp servers.
+    static uint32_t GetBudget(std::map<std::string, std::string>& stInterface, const char* szName, uint32_t dwDefault)
+    {
+        if(stInterface[szName].empty())
+            return dwDefault;
+        return strtoul(stInterface[szName].c_str(), NULL, 10);
     }
 
     void Run()
@@ -155,6 +208,13 @@ public:
 #endif
 
         Pool& pool = Pool::Instance();
+        if(!stGlobalConfig["max_events"].empty())
+            pool.SetMaxEvents(atoi(stGlobalConfig["max_events"].c_str()));
+
+        // busy_poll = spin microseconds, busy_poll_socket = SO_BUSY_POLL microseconds.
+        if(!stGlobalConfig["busy_poll"].empty())
+            pool.SetBusyPoll(atoi(stGlobalConfig["busy_poll"].c_str()), atoi(stGlobalConfig["busy_poll_socket"].c_str()));
+
         if(pool.Startup(concurrency) != 0)
             printf("[error] startup fail, %s.\n", safe_strerror(errno));
     }
@@ -256,6 +316,48 @@ public:
         public boost::noncopyable
     {
     public:
+        UdpServerStartup() :
+            m_bEdgeTriggered(false),
+            m_dwWakeupBudget(SERVER_WAKEUP_BUDGET),
+            m_dwBatchSize(0),
+            m_dwBatchSlotSize(UDPSERVER_BATCH_SLOT_SIZE),
+            m_bGro(false),
+            m_bReusePort(false),
+            m_bCpuSteering(false),
+            m_bDropCounter(false),
+            m_dwRecvBufferSize(0)
+        {
+        }
+
+        inline void SetGro(bool enable)
+        {
+            m_bGro = enable;
+        }
+
+        inline void SetReusePort(bool enable, bool cpuSteering)
+        {
+            m_bReusePort = enable;
+            m_bCpuSteering = cpuSteering;
+        }
+
+        inline void SetRecvBuffer(bool dropCounter, uint32_t size)
+        {
+            m_bDropCounter = dropCounter;
+            m_dwRecvBufferSize = size;
+        }
+
+        inline void SetEdgeTriggered(bool enable, uint32_t budget)
+        {
+            m_bEdgeTriggered = enable;
+            m_dwWakeupBudget = budget;
+        }
+
+        inline void SetBatch(uint32_t size, uint32_t slotSize)
+        {
+            m_dwBatchSize = size;
+            m_dwBatchSlotSize = slotSize;
+        }
+
         void Register(StartupDataT data)
         {
             m_Data = data;
@@ -268,16 +370,47 @@ public:
 
         bool OnStartup()
         {
-            m_Data.sin_port = htons(m_Data.sin_port + Pool::Instance().GetID());
-            if(PoolObject<ServerImplT>::Instance().Listen(m_Data) != 0)
+            ServerImplT& server = PoolObject<ServerImplT>::Instance();
+            if(m_bEdgeTriggered && server.SetEdgeTriggered(true, m_dwWakeupBudget) != 0)
+                return false;
+
+            if(server.SetBatch(m_dwBatchSize, m_dwBatchSlotSize) != 0)
+                return false;
+
+            // without UDP_GRO every datagram is read alone.
+            if(m_bGro)
+                server.SetGro(true);
+
+            if(m_bDropCounter && server.SetDropCounter(true) != 0)
+                LOG("enable SO_RXQ_OVFL fail, %s.", safe_strerror(errno));
+            if(m_dwRecvBufferSize > 0 && server.SetRecvBufferSize(m_dwRecvBufferSize) == -1)
+                LOG("set rcvbuf fail, %s.", safe_strerror(errno));
+
+            // the threads of a thread pool share m_Data.
+            StartupDataT addr = m_Data;
+            server.SetReusePort(m_bReusePort, m_bCpuSteering);
+            if(m_bReusePort)
+                addr.sin_port = htons(addr.sin_port);
+            else
+                addr.sin_port = htons(addr.sin_port + Pool::Instance().GetID());
+            if(server.Listen(addr) != 0)
                 return false;
 
             EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
-            return (scheduler.Register(&PoolObject<ServerImplT>::Instance(), EventScheduler::PollType::IN) == 0);
+            return (scheduler.Register(&server, EventScheduler::PollType::IN | server.GetEventFlags()) == 0);
         }
     
     private:
         StartupDataT m_Data;
+        bool m_bEdgeTriggered;
+        uint32_t m_dwWakeupBudget;
+        uint32_t m_dwBatchSize;
+        uint32_t m_dwBatchSlotSize;
+        bool m_bGro;
+        bool m_bReusePort;
+        bool m_bCpuSteering;
+        bool m_bDropCounter;
+        uint32_t m_dwRecvBufferSize;
     };
 
     template<typename ServerImplT, typename StartupDataT>
@@ -298,8 +431,18 @@ public:
 
         bool OnStartup()
         {
+            if(m_pServer->IsAcceptor())
+                return (Pool::Instance().GetID() != 0 || m_pServer->StartAcceptor() == 0);
+
             EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
-            return (scheduler.Register(m_pServer, EventScheduler::PollType::IN) == 0);
+            if(m_pServer->IsReusePort())
+            {
+                ServerInterface<void>* pListener = m_pServer->CreateListener(m_Data);
+                if(!pListener)
+                    return false;
+                return (scheduler.Register(pListener, EventScheduler::PollType::IN | EventScheduler::PollType::ACCEPT | m_pServer->GetEventFlags()) == 0);
+            }
+            return (scheduler.Register(m_pServer, EventScheduler::PollType::IN | m_pServer->GetListenEventFlags()) == 0);
         }
     
     private:
@@ -312,6 +455,24 @@ public:
         public boost::noncopyable
     {
     public:
+        TcpClientStartup() :
+            m_bEdgeTriggered(false),
+            m_dwWakeupBudget(SERVER_WAKEUP_BUDGET),
+            m_dwConnectTimeout(TCPCLIENT_CONNECT_TIMEOUT)
+        {
+        }
+
+        inline void SetConnectTimeout(uint32_t timeout)
+        {
+            m_dwConnectTimeout = timeout;
+        }
+
+        inline void SetEdgeTriggered(bool enable, uint32_t budget)
+        {
+            m_bEdgeTriggered = enable;
+            m_dwWakeupBudget = budget;
+        }
+
         void Register(StartupDataT data)
         {
             m_Data = data;
@@ -324,11 +485,21 @@ public:
 
         bool OnStartup()
         {
-            return (PoolObject<ClientImplT>::Instance().Connect(m_Data) == 0);
+            ClientImplT& client = PoolObject<ClientImplT>::Instance();
+            if(m_bEdgeTriggered)
+                client.SetEdgeTriggered(true, m_dwWakeupBudget);
+
+            // the connect only starts here, the clients of all startups
+            // connect side by side and report with OnConnected or OnConnectTimout.
+            client.SetConnectTimeout(m_dwConnectTimeout);
+            return (client.AsyncConnect(m_Data) == 0);
         }
     
     private:
         StartupDataT m_Data;
+        bool m_bEdgeTriggered;
+        uint32_t m_dwWakeupBudget;
+        uint32_t m_dwConnectTimeout;
     };
 
     class LogStartup
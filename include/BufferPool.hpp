@@ -0,0 +1,77 @@
+/*++
+ *
+ * Simple Server Library
+ * Author: NickeyWoo
+ * Date: 2026-10-17
+ *
+--*/
+#ifndef __BUFFERPOOL_HPP__
+#define __BUFFERPOOL_HPP__
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+#include <string>
+#include <boost/noncopyable.hpp>
+#include "PoolObject.hpp"
+
+#ifndef BUFFERPOOL_CHUNK_SIZE
+    // buffers are allocated and grown in chunks
+    #define BUFFERPOOL_CHUNK_SIZE       4096
+#endif
+
+#ifndef BUFFERPOOL_SCRATCH_SIZE
+    #define BUFFERPOOL_SCRATCH_SIZE     65536
+#endif
+
+#ifndef BUFFERPOOL_MAX_CLASS
+    // buffers up to BUFFERPOOL_MAX_CLASS chunks are kept on free lists
+    #define BUFFERPOOL_MAX_CLASS        16
+#endif
+
+#ifndef BUFFERPOOL_MAX_FREE
+    // free buffers kept per size class
+    #define BUFFERPOOL_MAX_FREE         256
+#endif
+
+//
+// per worker receive buffers, use PoolObject<BufferPool>::Instance().
+//   connections read into the shared scratch buffer and take a pooled
+//   buffer only while they hold a partial message.
+//
+class BufferPool :
+    public boost::noncopyable
+{
+public:
+    BufferPool();
+    ~BufferPool();
+
+    // a buffer of at least size bytes, the real size is rounded up to chunks.
+    char* Alloc(uint32_t size, uint32_t* pAllocSize);
+    void Free(char* buffer, uint32_t size);
+
+    inline char* GetScratch()
+    {
+        return m_pScratch;
+    }
+
+    inline uint32_t GetScratchSize()
+    {
+        return BUFFERPOOL_SCRATCH_SIZE;
+    }
+
+    void Dump(std::string& strDump);
+
+private:
+    char* m_pScratch;
+    std::vector<char*> m_FreeList[BUFFERPOOL_MAX_CLASS];
+
+    uint64_t m_AllocCount;
+    uint64_t m_HitCount;
+    uint64_t m_UsedSize;
+    uint64_t m_PeakUsedSize;
+    uint64_t m_UsedCount;
+};
+
+#endif // define __BUFFERPOOL_HPP__
+
@@ -8,6 +8,10 @@
 #ifndef __CHANNEL_HPP__
 #define __CHANNEL_HPP__
 
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
 #include <boost/function.hpp>
 #include "IOBuffer.hpp"
 
@@ -74,8 +78,82 @@ struct Channel<void> {
     }
 };
 
+//
+// non-throwing socket primitives for the hot paths. a result >= 0 is the
+// transferred size, otherwise one of ChannelStatus, errno keeps the reason
+// of CHANNEL_ERROR.
+//
+enum ChannelStatus
+{
+    CHANNEL_AGAIN   = -1,   // EAGAIN or EINTR, retry on the next event
+    CHANNEL_CLOSED  = -2,   // orderly shutdown of a stream peer
+    CHANNEL_ERROR   = -3
+};
+
+inline ssize_t GetChannelStatus(ssize_t size)
+{
+    if(size >= 0)
+        return size;
+    if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        return CHANNEL_AGAIN;
+    return CHANNEL_ERROR;
+}
+
+// stream read, 0 bytes from the peer is CHANNEL_CLOSED.
+inline ssize_t ChannelRecv(int fd, char* buffer, size_t size, int flags = MSG_DONTWAIT)
+{
+    ssize_t recvSize = recv(fd, buffer, size, flags);
+    if(recvSize == 0 && size > 0)
+        return CHANNEL_CLOSED;
+    return GetChannelStatus(recvSize);
+}
+
+// stream is true for stream sockets, a datagram may be empty.
+inline ssize_t ChannelRecvMsg(int fd, msghdr* msg, int flags, bool stream)
+{
+    ssize_t recvSize = recvmsg(fd, msg, flags);
+    if(recvSize == 0 && stream)
+        return CHANNEL_CLOSED;
+    return GetChannelStatus(recvSize);
+}
+
+inline ssize_t ChannelSend(int fd, const char* buffer, size_t size, int flags = MSG_DONTWAIT | MSG_NOSIGNAL)
+{
+    return GetChannelStatus(send(fd, buffer, size, flags));
+}
+
+inline ssize_t ChannelSendMsg(int fd, const msghdr* msg, int flags = MSG_DONTWAIT | MSG_NOSIGNAL)
+{
+    return GetChannelStatus(sendmsg(fd, msg, flags));
+}
+
+// sendfile and splice have no MSG_DONTWAIT, the sockets must be non-blocking.
+// a file that ends before the region is CHANNEL_ERROR with ENODATA.
+inline ssize_t ChannelSendFile(int fd, int filefd, off_t* offset, size_t size)
+{
+    ssize_t sendSize = sendfile(fd, filefd, offset, size);
+    if(sendSize == 0 && size > 0)
+    {
+        errno = ENODATA;
+        return CHANNEL_ERROR;
+    }
+    return GetChannelStatus(sendSize);
+}
+
+// one side of the splice is a pipe, 0 bytes from a socket is CHANNEL_CLOSED.
+inline ssize_t ChannelSplice(int infd, int outfd, size_t size)
+{
+    ssize_t spliceSize = splice(infd, NULL, outfd, NULL, size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if(spliceSize == 0 && size > 0)
+        return CHANNEL_CLOSED;
+    return GetChannelStatus(spliceSize);
+}
+
+// datagram form, read one message into io and keep the peer address in
+// channel.Address. stream channels overload ReadChannel and WriteChannel
+// with plain recv and send, see TcpServer.hpp.
 template<typename ChannelDataT>
-Channel<ChannelDataT>& operator >> (Channel<ChannelDataT>& channel, IOBuffer& io)
+ssize_t ReadChannel(Channel<ChannelDataT>& channel, IOBuffer& io, int flags = 0)
 {
     msghdr msg;
     bzero(&msg, sizeof(msghdr));
@@ -90,26 +168,19 @@ Channel<ChannelDataT>& operator >> (Channel<ChannelDataT>& channel, IOBuffer& io
     msg.msg_iov = &iov;
     msg.msg_iovlen = 1;
 
-    ssize_t recvSize = recvmsg(channel.Socket, &msg, 0);
-    if(recvSize == -1)
-        throw InternalException((boost::format("[%s:%d][error] recvmsg fail, %s.") % __FILE__ % __LINE__ % safe_strerror(errno)).str().c_str());
+    ssize_t recvSize = ChannelRecvMsg(channel.Socket, &msg, flags, false);
 
-    io.m_AvailableReadSize = recvSize;
+    io.m_AvailableReadSize = (recvSize > 0) ? recvSize : 0;
     io.m_ReadPosition = 0;
-    return channel;
-}
-
-template<typename ChannelDataT>
-inline Channel<ChannelDataT>& operator >> (Channel<ChannelDataT>& channel, IOBuffer* pIOBuffer)
-{
-    return channel >> *pIOBuffer;
+    return recvSize;
 }
 
+// write the bytes of io to channel.Address, io is emptied once sent.
 template<typename ChannelDataT>
-Channel<ChannelDataT>& operator << (Channel<ChannelDataT>& channel, IOBuffer& io)
+ssize_t WriteChannel(Channel<ChannelDataT>& channel, IOBuffer& io, int flags = MSG_NOSIGNAL)
 {
     if(io.m_WritePosition == 0)
-        return channel;
+        return 0;
 
     msghdr msg;
     bzero(&msg, sizeof(msghdr));
@@ -124,11 +195,33 @@ Channel<ChannelDataT>& operator << (Channel<ChannelDataT>& channel, IOBuffer& io
     msg.msg_iov = &iov;
     msg.msg_iovlen = 1;
 
-    ssize_t sendSize = sendmsg(channel.Socket, &msg, 0);
-    if(sendSize == -1)
-        throw InternalException((boost::format("[%s:%d][error] sendmsg fail, %s.") % __FILE__ % __LINE__ % safe_strerror(errno)).str().c_str());
+    ssize_t sendSize = ChannelSendMsg(channel.Socket, &msg, flags);
+    if(sendSize >= 0)
+        io.m_WritePosition = 0;
+    return sendSize;
+}
 
-    io.m_WritePosition = 0;
+// throwing forms, nothing read on CHANNEL_AGAIN leaves io empty.
+template<typename ChannelDataT>
+Channel<ChannelDataT>& operator >> (Channel<ChannelDataT>& channel, IOBuffer& io)
+{
+    if(ReadChannel(channel, io) == CHANNEL_ERROR)
+        throw InternalException((boost::format("[%s:%d][error] recvmsg fail, %s.") % __FILE__ % __LINE__ % safe_strerror(errno)).str().c_str());
+    return channel;
+}
+
+template<typename ChannelDataT>
+inline Channel<ChannelDataT>& operator >> (Channel<ChannelDataT>& channel, IOBuffer* pIOBuffer)
+{
+    return channel >> *pIOBuffer;
+}
+
+// a reply that could not be sent is an error here, use WriteChannel to retry.
+template<typename ChannelDataT>
+Channel<ChannelDataT>& operator << (Channel<ChannelDataT>& channel, IOBuffer& io)
+{
+    if(WriteChannel(channel, io, 0) < 0)
+        throw InternalException((boost::format("[%s:%d][error] sendmsg fail, %s.") % __FILE__ % __LINE__ % safe_strerror(errno)).str().c_str());
     return channel;
 }
 
@@ -11,6 +11,7 @@
 #include <utility>
 #include <list>
 #include <string>
+#include <stdint.h>
 #include <time.h>
 #include <boost/noncopyable.hpp>
 #include "PoolObject.hpp"
@@ -48,6 +49,29 @@
 #define CLOCK_CLEAR()                                                                                                       \
         PoolObject<Clock>::Instance().Clear()
 
+// cheap timestamp for always-on counters, cpu cycles where rdtsc exists,
+// otherwise CLOCK_MONOTONIC_COARSE nanoseconds. convert with a second
+// clock_gettime sample, see EventLoopStats.
+static inline uint64_t ReadCycleCounter()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static inline uint64_t ReadMonotonicClock()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 class Clock :
     public boost::noncopyable
 {
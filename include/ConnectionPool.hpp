@@ -197,6 +197,33 @@ public:
         return 0;
     }
 
+    // attach a client and start its connect unless it is connected. 1 if it
+    // is connected and can send right away, 0 while the connect is in
+    // progress, OnConnected or OnConnectTimout of the client tells the
+    // result. -1 on failure.
+    int AsyncAttach(sockaddr_in& stAddr, TcpClientT** ppstClient)
+    {
+        if(Attach(stAddr, ppstClient) != 0)
+            return -1;
+
+        TcpClientT* pstClient = *ppstClient;
+        if(pstClient->IsConnecting())
+            return 0;
+
+        if(pstClient->IsConnected())
+            return 1;
+
+        // a failed client goes back idle, OnConnectTimout may have detached
+        // it already.
+        if(pstClient->Reconnect(stAddr) != 0)
+        {
+            Detach(pstClient);
+            *ppstClient = NULL;
+            return -1;
+        }
+        return 0;
+    }
+
     void Detach(TcpClientT* pstClient)
     {
         ConnectionInfo<TcpClientT, TimerInterval>* pConnInfo = 
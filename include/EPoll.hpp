@@ -8,10 +8,21 @@
 #ifndef __EPOLL_HPP__
 #define __EPOLL_HPP__
 
+#include <sys/uio.h>
 #include <sys/epoll.h>
+#include <netinet/in.h>
 #include <boost/noncopyable.hpp>
 #include "Server.hpp"
 
+#ifndef EPOLL_DEFAULT_MAXEVENTS
+    #define EPOLL_DEFAULT_MAXEVENTS 256
+#endif
+
+#ifndef EPOLLEXCLUSIVE
+    // linux 4.5, missing from older headers
+    #define EPOLLEXCLUSIVE  (1u << 28)
+#endif
+
 class EPoll :
     public boost::noncopyable
 {
@@ -29,28 +40,90 @@ public:
         IN = EPOLLIN,
         OUT = EPOLLOUT,
         ERR = EPOLLERR,
-        HUP = EPOLLHUP
+        HUP = EPOLLHUP,
+        ET = EPOLLET,
+        EXCLUSIVE = EPOLLEXCLUSIVE,
+        // the sockets are read and accepted by syscall, see IoUring.
+        RECV = 0,
+        ACCEPT = 0
     };
 
-    int CreatePoll();
+    int CreatePoll(int maxEvents = EPOLL_DEFAULT_MAXEVENTS);
     void Close();
     int EventCtl(int opeartor, uint32_t events, int fd, void* ptr);
 
+    inline int GetMaxEvents()
+    {
+        return m_MaxEvents;
+    }
+
+    // wait for up to max events, the result is fetched with NextEvent.
+    inline int WaitEvent(int timeout)
+    {
+        m_Current = 0;
+        m_Ready = epoll_wait(m_epfd, m_pEvents, m_MaxEvents, timeout);
+        if(m_Ready < 0)
+        {
+            int ready = m_Ready;
+            m_Ready = 0;
+            return ready;
+        }
+        return m_Ready;
+    }
+
     template<typename DataT>
-    inline int WaitEvent(ServerInterface<DataT>** ppInterface, uint32_t* pEvents, int timeout)
+    inline bool NextEvent(ServerInterface<DataT>** ppInterface, uint32_t* pEvents)
     {
-        epoll_event ev;
-        bzero(&ev, sizeof(epoll_event));
+        while(m_Current < m_Ready)
+        {
+            epoll_event& ev = m_pEvents[m_Current++];
+            if(ev.data.ptr == NULL)
+                continue;
 
-        int ret = epoll_wait(m_epfd, &ev, 1, timeout);
+            *ppInterface = (ServerInterface<DataT>*)ev.data.ptr;
+            *pEvents = ev.events;
+            return true;
+        }
+        return false;
+    }
 
-        *ppInterface = (ServerInterface<DataT>*)ev.data.ptr;
-        *pEvents = ev.events;
-        return ret;
+    // stream read into iov, the size or a ChannelStatus.
+    inline ssize_t Recv(int fd, iovec* iov, int count, int flags = MSG_DONTWAIT)
+    {
+        if(count == 1)
+            return ChannelRecv(fd, (char*)iov[0].iov_base, iov[0].iov_len, flags);
+
+        msghdr msg;
+        bzero(&msg, sizeof(msghdr));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        return ChannelRecvMsg(fd, &msg, flags, true);
+    }
+
+#ifdef __USE_GNU
+    inline int Accept(int fd, sockaddr_in* addr, int flags)
+    {
+        socklen_t len = sizeof(sockaddr_in);
+        return accept4(fd, (sockaddr*)addr, &len, flags);
+    }
+#endif
+
+    // drop the pending events of the unregistered interface in current batch.
+    inline void Forget(void* ptr)
+    {
+        for(int i = m_Current; i < m_Ready; ++i)
+        {
+            if(m_pEvents[i].data.ptr == ptr)
+                m_pEvents[i].data.ptr = NULL;
+        }
     }
 
 private:
     int m_epfd;
+    int m_MaxEvents;
+    int m_Ready;
+    int m_Current;
+    epoll_event* m_pEvents;
 };
 
 #endif // define __EPOLL_HPP__
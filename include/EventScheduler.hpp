@@ -20,13 +20,137 @@
 #include <exception>
 #include <time.h>
 #include <sys/time.h>
+#include <sys/eventfd.h>
 #include <boost/noncopyable.hpp>
 #include <boost/function.hpp>
 #include <boost/bind.hpp>
+#include <boost/format.hpp>
 #include "EPoll.hpp"
+#if defined(EVENTSCHEDULER_USE_IOURING)
+    #include "IoUring.hpp"
+#endif
 #include "Clock.hpp"
 #include "Log.hpp"
 
+#ifndef EVENTSCHEDULER_MIN_SPIN_TIME
+    // floor of the adaptive busy-poll window, in microseconds
+    #define EVENTSCHEDULER_MIN_SPIN_TIME    4
+#endif
+
+// callback durations, 4 buckets per power of two cycles.
+#define EVENTLOOP_HISTOGRAM_SIZE    256
+
+struct EventLoopStats
+{
+    uint64_t Iterations;
+    uint64_t Wakeups;
+    uint64_t Events;
+    uint64_t MaxEventsPerWakeup;
+
+    uint64_t WaitCycles;
+    uint64_t CallbackCycles;
+    uint64_t TaskCycles;
+    uint64_t LoopCallbackCycles;
+    uint64_t IdleCallbackCycles;
+
+    // busy-poll, zero timeout polls inside the spin window, the ones that
+    // found events, and windows that ran out before an event came in.
+    uint64_t SpinPolls;
+    uint64_t SpinHits;
+    uint64_t SpinMisses;
+    uint32_t SpinTime;
+
+    // callbacks run again from the ready list.
+    uint64_t ReadyCallbacks;
+    // deferred OnWriteable callbacks from the flush list.
+    uint64_t FlushCallbacks;
+
+    uint64_t Callbacks;
+    uint64_t MaxCallbackCycles;
+    uint64_t CallbackHistogram[EVENTLOOP_HISTOGRAM_SIZE];
+
+    // cycle to time conversion base.
+    uint64_t StartCycles;
+    uint64_t StartClock;
+
+    inline void Reset()
+    {
+        bzero(this, sizeof(EventLoopStats));
+        StartCycles = ReadCycleCounter();
+        StartClock = ReadMonotonicClock();
+    }
+
+    inline void RecordCallback(uint64_t cycles)
+    {
+        ++Callbacks;
+        CallbackCycles += cycles;
+        if(cycles > MaxCallbackCycles)
+            MaxCallbackCycles = cycles;
+
+        int msb = 63 - __builtin_clzll(cycles | 1);
+        uint32_t index = (msb < 2) ? (uint32_t)cycles : (msb << 2 | ((cycles >> (msb - 2)) & 3));
+        ++CallbackHistogram[index];
+    }
+
+    // upper bound of the callback duration for the percent.
+    uint64_t GetCallbackPercentile(double percent)
+    {
+        uint64_t count = (uint64_t)(Callbacks * percent / 100);
+        uint64_t total = 0;
+        for(uint32_t i = 0; i < EVENTLOOP_HISTOGRAM_SIZE; ++i)
+        {
+            total += CallbackHistogram[i];
+            if(total > count)
+            {
+                uint32_t msb = i >> 2;
+                if(msb < 2)
+                    return i + 1;
+                return ((uint64_t)(4 | (i & 3)) + 1) << (msb - 2);
+            }
+        }
+        return MaxCallbackCycles;
+    }
+
+    inline double GetCyclesPerMicrosecond()
+    {
+        uint64_t clock = ReadMonotonicClock() - StartClock;
+        if(clock == 0)
+            return 1;
+        return (double)(ReadCycleCounter() - StartCycles) * 1000 / clock;
+    }
+
+    void Dump(std::string& strDump)
+    {
+        double cpus = GetCyclesPerMicrosecond();
+        strDump.append((boost::format("Iterations: %lu\n") % Iterations).str());
+        strDump.append((boost::format("Wakeups: %lu\n") % Wakeups).str());
+        strDump.append((boost::format("Events: %lu, %.02f per wakeup, max %lu\n") 
+                            % Events % (Wakeups ? (double)Events / Wakeups : 0) % MaxEventsPerWakeup).str());
+        strDump.append((boost::format("Ready List: %lu callbacks\n") % ReadyCallbacks).str());
+        strDump.append((boost::format("Flush List: %lu callbacks\n") % FlushCallbacks).str());
+        strDump.append((boost::format("Wait Time: %.03fms\n") % (WaitCycles / cpus / 1000)).str());
+        strDump.append((boost::format("Callback Time: %.03fms, %lu calls, max %.03fus, p99 %.03fus\n")
+                            % (CallbackCycles / cpus / 1000) % Callbacks
+                            % (MaxCallbackCycles / cpus) % (GetCallbackPercentile(99) / cpus)).str());
+        if(SpinPolls > 0 || SpinMisses > 0)
+        {
+            strDump.append((boost::format("Busy Poll: %lu polls, %lu hits, %lu misses, %.02f%% hit rate, spin %uus\n")
+                                % SpinPolls % SpinHits % SpinMisses
+                                % ((SpinHits + SpinMisses) ? (double)SpinHits * 100 / (SpinHits + SpinMisses) : 0)
+                                % SpinTime).str());
+        }
+        strDump.append((boost::format("Posted Task Time: %.03fms\n") % (TaskCycles / cpus / 1000)).str());
+        strDump.append((boost::format("Loop Callback Time: %.03fms\n") % (LoopCallbackCycles / cpus / 1000)).str());
+        strDump.append((boost::format("Idle Callback Time: %.03fms\n") % (IdleCallbackCycles / cpus / 1000)).str());
+    }
+};
+
+struct EventSchedulerTask
+{
+    EventSchedulerTask* NextTask;
+    boost::function<void(void)> Callback;
+};
+
 template<typename PollT>
 class EventSchedulerImpl :
     public boost::noncopyable
@@ -44,6 +168,13 @@ public:
         m_LoopCallbackList.push_back(callback);
     }
 
+    // the callback returns milliseconds until its next deadline, -1 if none.
+    // the loop blocks no longer than the nearest deadline or idle timeout.
+    inline void RegisterTimeoutCallback(boost::function<int(void)> callback)
+    {
+        m_TimeoutCallbackList.push_back(callback);
+    }
+
     inline int GetIdleTimeout()
     {
         return m_IdleTimeout;
@@ -56,14 +187,133 @@ public:
         return to;
     }
 
-    inline int CreateScheduler()
+    // spin with zero timeout polls for up to spinTime microseconds after the
+    // last event before blocking. the window halves every time it runs out
+    // empty and doubles back on a hit. socketBusyPoll sets SO_BUSY_POLL on
+    // sockets registered afterwards. 0 disables.
+    inline int SetBusyPoll(int spinTime, int socketBusyPoll = 0)
+    {
+        int old = m_BusyPollTime;
+        m_BusyPollTime = (spinTime < 0) ? 0 : spinTime;
+        m_SpinTime = m_BusyPollTime;
+        m_SocketBusyPoll = socketBusyPoll;
+        m_bSpinning = false;
+        m_LoopStats.SpinTime = m_SpinTime;
+        return old;
+    }
+
+    inline int GetBusyPoll()
+    {
+        return m_BusyPollTime;
+    }
+
+    // sockets registered with PollType::RECV or ACCEPT are read through it.
+    inline PollT& GetPoll()
+    {
+        return m_Poll;
+    }
+
+    int CreateScheduler(int maxEvents = EPOLL_DEFAULT_MAXEVENTS)
     {
-        return m_Poll.CreatePoll();
+        int fd = m_Poll.CreatePoll(maxEvents);
+        if(fd == -1)
+            return -1;
+
+        // wakeup fd of the posted task queue.
+        m_PostInterface.m_Channel.Socket = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(m_PostInterface.m_Channel.Socket == -1)
+        {
+            m_Poll.Close();
+            return -1;
+        }
+
+        m_PostInterface.m_ReadableCallback = boost::bind(&EventSchedulerImpl<PollT>::OnPostReadable, this, _1);
+        if(Register(&m_PostInterface, PollT::IN) == -1)
+        {
+            close(m_PostInterface.m_Channel.Socket);
+            m_PostInterface.m_Channel.Socket = -1;
+            m_Poll.Close();
+            return -1;
+        }
+        return fd;
     }
 
-    inline void Close()
+    void Close()
     {
+        if(m_PostInterface.m_Channel.Socket != -1)
+        {
+            close(m_PostInterface.m_Channel.Socket);
+            m_PostInterface.m_Channel.Socket = -1;
+        }
         m_Poll.Close();
+
+        EventSchedulerTask* pTask = __sync_lock_test_and_set(&m_pPostTaskList, (EventSchedulerTask*)NULL);
+        while(pTask)
+        {
+            EventSchedulerTask* pNextTask = pTask->NextTask;
+            delete pTask;
+            pTask = pNextTask;
+        }
+    }
+
+    // thread-safe, the callback runs in the loop thread on the next iteration.
+    void Post(boost::function<void(void)> callback)
+    {
+        EventSchedulerTask* pTask = new EventSchedulerTask();
+        pTask->Callback = callback;
+
+        EventSchedulerTask* pHead = m_pPostTaskList;
+        while(true)
+        {
+            pTask->NextTask = pHead;
+            EventSchedulerTask* pPrev = __sync_val_compare_and_swap(&m_pPostTaskList, pHead, pTask);
+            if(pPrev == pHead)
+                break;
+            pHead = pPrev;
+        }
+
+        // only the first task of an empty queue wakes the loop up.
+        if(pHead == NULL)
+        {
+            uint64_t wakeup = 1;
+            write(m_PostInterface.m_Channel.Socket, &wakeup, sizeof(uint64_t));
+        }
+    }
+
+    // run now in the loop thread, or post from another thread.
+    inline void RunInLoop(boost::function<void(void)> callback)
+    {
+        if(IsInLoopThread())
+            callback();
+        else
+            Post(callback);
+    }
+
+    // per worker loop counters, always on.
+    inline EventLoopStats& GetLoopStats()
+    {
+        return m_LoopStats;
+    }
+
+    inline void ResetLoopStats()
+    {
+        m_LoopStats.Reset();
+        m_LoopStats.SpinTime = m_SpinTime;
+    }
+
+    inline void DumpLoopStats(std::string& strDump)
+    {
+        m_LoopStats.Dump(strDump);
+    }
+
+    inline bool IsInLoopThread()
+    {
+        return m_bLoopRunning && pthread_equal(m_LoopThread, pthread_self());
+    }
+
+    inline void Quit()
+    {
+        m_Quit = true;
     }
 
     template<typename ServiceT>
@@ -72,9 +322,58 @@ public:
         return UnRegister(&pService->m_ServerInterface);
     }
 
+    // run OnReadable again on the next iteration without waiting for the poll,
+    // for handlers that stopped on their wakeup budget with input left.
+    template<typename ServiceT>
+    inline void SetReady(ServiceT* pService)
+    {
+        SetReady(&pService->m_ServerInterface);
+    }
+
+    template<typename ChannelDataT>
+    inline void SetReady(ServerInterface<ChannelDataT>* pServerInterface)
+    {
+        if(pServerInterface->m_bReady)
+            return;
+
+        pServerInterface->m_bReady = true;
+        m_ReadyList.push_back(reinterpret_cast<ServerInterface<void>*>(pServerInterface));
+    }
+
+    // run OnWriteable once at the end of this iteration, before the next
+    // wait, to flush what the handler gathered during the iteration.
+    template<typename ServiceT>
+    inline void SetFlush(ServiceT* pService)
+    {
+        SetFlush(&pService->m_ServerInterface);
+    }
+
+    template<typename ChannelDataT>
+    inline void SetFlush(ServerInterface<ChannelDataT>* pServerInterface)
+    {
+        if(pServerInterface->m_bFlush)
+            return;
+
+        pServerInterface->m_bFlush = true;
+        m_FlushList.push_back(reinterpret_cast<ServerInterface<void>*>(pServerInterface));
+    }
+
+    // true once the callback being dispatched unregistered its interface, it
+    // may be deleted already.
+    inline bool IsDispatchReleased()
+    {
+        return m_pDispatchInterface != NULL && m_bDispatchReleased;
+    }
+
     template<typename ChannelDataT>
     inline int UnRegister(ServerInterface<ChannelDataT>* pServerInterface)
     {
+        if(pServerInterface == m_pDispatchInterface)
+            m_bDispatchReleased = true;
+
+        m_Poll.Forget(pServerInterface);
+        if(pServerInterface->m_bReady || pServerInterface->m_bFlush)
+            ForgetInterface(pServerInterface);
         return m_Poll.EventCtl(PollT::DEL, 0, pServerInterface->m_Channel.Socket, NULL);
     }
 
@@ -103,6 +402,11 @@ public:
     template<typename ChannelDataT>
     inline int Register(ServerInterface<ChannelDataT>* pServerInterface, int events)
     {
+#ifdef SO_BUSY_POLL
+        // best effort, fails on non-sockets or without CAP_NET_ADMIN.
+        if(m_SocketBusyPoll > 0)
+            setsockopt(pServerInterface->m_Channel.Socket, SOL_SOCKET, SO_BUSY_POLL, &m_SocketBusyPoll, sizeof(int));
+#endif
         return m_Poll.EventCtl(PollT::ADD, events, pServerInterface->m_Channel.Socket, pServerInterface);
     }
 
@@ -119,7 +423,10 @@ public:
         bzero(&stPollInfo, sizeof(pollfd));
 
         stPollInfo.fd = pServerInterface->m_Channel.Socket;
-        stPollInfo.events = POLLIN;
+        if((events & PollT::IN) == PollT::IN)
+            stPollInfo.events |= POLLIN;
+        if((events & PollT::OUT) == PollT::OUT)
+            stPollInfo.events |= POLLOUT;
 
         int timeout = -1;
         if(tv != NULL)
@@ -131,23 +438,83 @@ public:
     void Dispatch()
     {
         LDEBUG_CLOCK_TRACE("start event dispatch loop...");
+        m_LoopThread = pthread_self();
+        m_bLoopRunning = true;
         while(!m_Quit)
         {
-            ServerInterface<void>* pInterface = NULL;
-            uint32_t events;
-            int ready = m_Poll.WaitEvent(&pInterface, &events, m_IdleTimeout);
-            try
+            // do not block while the ready list has work left or replies
+            // are waiting for their deferred flush.
+            int timeout = (m_ReadyList.empty() && m_FlushList.empty()) ? GetWaitTimeout() : 0;
+            if(m_BusyPollTime > 0)
+                timeout = GetSpinTimeout(timeout);
+
+            uint64_t cycles = ReadCycleCounter();
+            int ready = m_Poll.WaitEvent(timeout);
+
+            uint64_t now = ReadCycleCounter();
+            m_LoopStats.WaitCycles += now - cycles;
+            ++m_LoopStats.Iterations;
+
+            if(ready > 0)
             {
-                if(ready > 0)
+                if(m_BusyPollTime > 0)
+                    OnSpinEvent();
+
+                ++m_LoopStats.Wakeups;
+                m_LoopStats.Events += ready;
+                if((uint64_t)ready > m_LoopStats.MaxEventsPerWakeup)
+                    m_LoopStats.MaxEventsPerWakeup = ready;
+
+                ServerInterface<void>* pInterface = NULL;
+                uint32_t events = 0;
+                while(m_Poll.NextEvent(&pInterface, &events))
                 {
-                    if((events & PollT::ERR) == PollT::ERR)
-                        pInterface->OnError();
-                    else if((events & PollT::IN) == PollT::IN)
-                        pInterface->OnReadable();
-                    else if((events & PollT::OUT) == PollT::OUT)
-                        pInterface->OnWriteable();
+                    // handle every ready bit in one pass, read first, then write, 
+                    // then hangup or error. stop once the interface is unregistered
+                    // by the callback, it may already be deleted.
+                    m_pDispatchInterface = pInterface;
+                    m_bDispatchReleased = false;
+                    try
+                    {
+                        if((events & PollT::IN) == PollT::IN)
+                            pInterface->OnReadable();
+
+                        if(!m_bDispatchReleased && (events & PollT::OUT) == PollT::OUT)
+                            pInterface->OnWriteable();
+
+                        // a hangup with pending data is left to the read handler.
+                        if(!m_bDispatchReleased && 
+                           ((events & PollT::ERR) == PollT::ERR || (events & (PollT::HUP | PollT::IN)) == PollT::HUP))
+                            pInterface->OnError();
+                    }
+                    catch(std::exception& error)
+                    {
+                        // ignore error
+                        LOG("unknown error: %s", error.what());
+                    }
+                    m_pDispatchInterface = NULL;
+
+                    cycles = now;
+                    now = ReadCycleCounter();
+                    m_LoopStats.RecordCallback(now - cycles);
                 }
-                else if(ready == 0)
+            }
+
+            // interfaces with input left over from their last wakeup, in order,
+            // once per iteration after the polled events.
+            bool bReadyRun = !m_ReadyList.empty();
+            if(bReadyRun)
+                RunInterfaceList(m_ReadyList, false, now);
+
+            RunPostTasks();
+
+            cycles = now;
+            now = ReadCycleCounter();
+            m_LoopStats.TaskCycles += now - cycles;
+
+            try
+            {
+                if(ready == 0 && !bReadyRun && !m_bSpinning)
                 {
                     for(std::list<boost::function<void(void)> >::iterator iter = m_IdleCallbackList.begin();
                         iter != m_IdleCallbackList.end();
@@ -155,6 +522,10 @@ public:
                     {
                         (*iter)();
                     }
+
+                    cycles = now;
+                    now = ReadCycleCounter();
+                    m_LoopStats.IdleCallbackCycles += now - cycles;
                 }
                 for(std::list<boost::function<void(void)> >::iterator iter = m_LoopCallbackList.begin();
                     iter != m_LoopCallbackList.end();
@@ -168,23 +539,214 @@ public:
                 // ignore error
                 LOG("unknown error: %s", error.what());
             }
+
+            cycles = now;
+            now = ReadCycleCounter();
+            m_LoopStats.LoopCallbackCycles += now - cycles;
+
+            // replies gathered during the iteration go out in one write each.
+            if(!m_FlushList.empty())
+                RunInterfaceList(m_FlushList, true, now);
         }
+        m_bLoopRunning = false;
+
+        // the scheduler can dispatch again after Quit.
+        m_Quit = false;
     }
 
     EventSchedulerImpl() :
         m_Quit(false),
-        m_IdleTimeout(-1)
+        m_IdleTimeout(-1),
+        m_pDispatchInterface(NULL),
+        m_bDispatchReleased(false),
+        m_bLoopRunning(false),
+        m_pPostTaskList(NULL),
+        m_BusyPollTime(0),
+        m_SpinTime(0),
+        m_SocketBusyPoll(0),
+        m_bSpinning(false),
+        m_LastEventClock(0)
     {
+        m_LoopStats.Reset();
     }
 
 protected:
+    int GetWaitTimeout()
+    {
+        int timeout = m_IdleTimeout;
+        for(std::list<boost::function<int(void)> >::iterator iter = m_TimeoutCallbackList.begin();
+            iter != m_TimeoutCallbackList.end();
+            ++iter)
+        {
+            int deadline = (*iter)();
+            if(deadline >= 0 && (timeout < 0 || deadline < timeout))
+                timeout = deadline;
+        }
+        return timeout;
+    }
+
+    int GetSpinTimeout(int timeout)
+    {
+        if(timeout == 0)
+            return 0;
+
+        if(ReadMonotonicClock() - m_LastEventClock < (uint64_t)m_SpinTime * 1000)
+        {
+            m_bSpinning = true;
+            ++m_LoopStats.SpinPolls;
+            return 0;
+        }
+
+        if(m_bSpinning)
+        {
+            // the window ran out without an event, spin less next time.
+            m_bSpinning = false;
+            m_SpinTime = (m_SpinTime / 2 < EVENTSCHEDULER_MIN_SPIN_TIME) ? EVENTSCHEDULER_MIN_SPIN_TIME : m_SpinTime / 2;
+            if(m_SpinTime > m_BusyPollTime)
+                m_SpinTime = m_BusyPollTime;
+            m_LoopStats.SpinTime = m_SpinTime;
+            ++m_LoopStats.SpinMisses;
+        }
+        return timeout;
+    }
+
+    void OnSpinEvent()
+    {
+        if(m_bSpinning)
+        {
+            ++m_LoopStats.SpinHits;
+            m_SpinTime = (m_SpinTime * 2 > m_BusyPollTime) ? m_BusyPollTime : m_SpinTime * 2;
+            m_LoopStats.SpinTime = m_SpinTime;
+        }
+        m_LastEventClock = ReadMonotonicClock();
+    }
+
+    // OnReadable for the ready list, OnWriteable for the flush list.
+    void RunInterfaceList(std::vector<ServerInterface<void>*>& list, bool bWriteable, uint64_t& now)
+    {
+        m_RunList.swap(list);
+        for(size_t i = 0; i < m_RunList.size(); ++i)
+        {
+            ServerInterface<void>* pInterface = m_RunList[i];
+            if(pInterface == NULL)
+                continue;
+
+            m_pDispatchInterface = pInterface;
+            m_bDispatchReleased = false;
+            try
+            {
+                if(bWriteable)
+                {
+                    pInterface->m_bFlush = false;
+                    pInterface->OnWriteable();
+                }
+                else
+                {
+                    pInterface->m_bReady = false;
+                    pInterface->OnReadable();
+                }
+            }
+            catch(std::exception& error)
+            {
+                // ignore error
+                LOG("unknown error: %s", error.what());
+            }
+            m_pDispatchInterface = NULL;
+
+            uint64_t cycles = now;
+            now = ReadCycleCounter();
+            m_LoopStats.RecordCallback(now - cycles);
+            if(bWriteable)
+                ++m_LoopStats.FlushCallbacks;
+            else
+                ++m_LoopStats.ReadyCallbacks;
+        }
+        m_RunList.clear();
+    }
+
+    static void ForgetInterface(std::vector<ServerInterface<void>*>& list, void* ptr)
+    {
+        for(size_t i = 0; i < list.size(); ++i)
+        {
+            if(list[i] == ptr)
+                list[i] = NULL;
+        }
+    }
+
+    void ForgetInterface(void* ptr)
+    {
+        ForgetInterface(m_ReadyList, ptr);
+        ForgetInterface(m_FlushList, ptr);
+        ForgetInterface(m_RunList, ptr);
+    }
+
+    void OnPostReadable(ServerInterface<void>* pInterface)
+    {
+        uint64_t count;
+        read(pInterface->m_Channel.Socket, &count, sizeof(uint64_t));
+    }
+
+    void RunPostTasks()
+    {
+        if(m_pPostTaskList == NULL)
+            return;
+
+        // take the whole queue and reverse it into posting order.
+        EventSchedulerTask* pTask = __sync_lock_test_and_set(&m_pPostTaskList, (EventSchedulerTask*)NULL);
+        EventSchedulerTask* pFifo = NULL;
+        while(pTask)
+        {
+            EventSchedulerTask* pNextTask = pTask->NextTask;
+            pTask->NextTask = pFifo;
+            pFifo = pTask;
+            pTask = pNextTask;
+        }
+
+        while(pFifo)
+        {
+            EventSchedulerTask* pNextTask = pFifo->NextTask;
+            try
+            {
+                pFifo->Callback();
+            }
+            catch(std::exception& error)
+            {
+                LOG("posted task error: %s", error.what());
+            }
+            delete pFifo;
+            pFifo = pNextTask;
+        }
+    }
+
     bool m_Quit;
     int m_IdleTimeout;
     PollT m_Poll;
+    void* m_pDispatchInterface;
+    bool m_bDispatchReleased;
+    bool m_bLoopRunning;
+    pthread_t m_LoopThread;
+    ServerInterface<void> m_PostInterface;
+    EventSchedulerTask* volatile m_pPostTaskList;
+    EventLoopStats m_LoopStats;
+    std::vector<ServerInterface<void>*> m_ReadyList;
+    std::vector<ServerInterface<void>*> m_FlushList;
+    std::vector<ServerInterface<void>*> m_RunList;
+    int m_BusyPollTime;
+    int m_SpinTime;
+    int m_SocketBusyPoll;
+    bool m_bSpinning;
+    uint64_t m_LastEventClock;
     std::list<boost::function<void(void)> > m_IdleCallbackList;
     std::list<boost::function<void(void)> > m_LoopCallbackList;
+    std::list<boost::function<int(void)> > m_TimeoutCallbackList;
 };
 
-typedef EventSchedulerImpl<EPoll> EventScheduler;
+// the io_uring backend is experimental, echobench shows no steady gain over
+// epoll yet. build with -DEVENTSCHEDULER_USE_IOURING and measure first.
+#if defined(EVENTSCHEDULER_USE_IOURING)
+    typedef EventSchedulerImpl<IoUring> EventScheduler;
+#else
+    typedef EventSchedulerImpl<EPoll> EventScheduler;
+#endif
 
 #endif // define __EVENTSCHEDULER_HPP__
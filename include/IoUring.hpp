@@ -0,0 +1,219 @@
+/*++
+ *
+ * Simple Server Library
+ * Author: NickeyWoo
+ * Date: 2026-10-17
+ *
+--*/
+#ifndef __IOURING_HPP__
+#define __IOURING_HPP__
+
+#include <poll.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <linux/io_uring.h>
+#include <vector>
+#include <deque>
+#include <map>
+#include <boost/noncopyable.hpp>
+#include "Server.hpp"
+#include "EPoll.hpp"
+
+#ifndef IOURING_BUFFER_COUNT
+    // provided receive buffers of a ring, a power of 2
+    #define IOURING_BUFFER_COUNT    1024
+#endif
+
+#ifndef IOURING_BUFFER_SIZE
+    #define IOURING_BUFFER_SIZE     4096
+#endif
+
+#ifndef IOURING_MAX_FILES
+    // registered file table, sockets past it are passed by fd
+    #define IOURING_MAX_FILES       65536
+#endif
+
+//
+// io_uring poller, same interface as EPoll. experimental, on loopback echo
+// it is within the noise of EPoll, from 0.83x to 1.25x.
+//   level-triggered registrations are oneshot poll requests re-armed before
+//   the next wait, EPOLLET registrations use a multishot poll request.
+//   all EventCtl changes are queued and submitted with the next wait in one
+//   io_uring_enter call.
+//
+//   a socket added with RECV is read by a multishot recv into the provided
+//   buffer ring, a listener added with ACCEPT by a multishot accept. IN is
+//   then reported from the completions, Recv and Accept take the data from
+//   the poller instead of the socket. both sockets are in the registered
+//   file table while added. a RECV socket modified without IN has its recv
+//   cancelled, it does not take buffers of the ring while paused.
+//
+class IoUring :
+    public boost::noncopyable
+{
+public:
+    IoUring();
+    ~IoUring();
+
+    enum {
+        ADD = EPOLL_CTL_ADD,
+        MOD = EPOLL_CTL_MOD,
+        DEL = EPOLL_CTL_DEL
+    };
+
+    enum {
+        IN = POLLIN,
+        OUT = POLLOUT,
+        ERR = POLLERR,
+        HUP = POLLHUP,
+        ET = EPOLLET,
+        // no exclusive wakeup for poll requests, every ring is woken.
+        EXCLUSIVE = 0,
+        // completion based read or accept, fixed on ADD.
+        RECV = 0x04000000,
+        ACCEPT = 0x08000000
+    };
+
+    int CreatePoll(int maxEvents = EPOLL_DEFAULT_MAXEVENTS);
+    void Close();
+    int EventCtl(int opeartor, uint32_t events, int fd, void* ptr);
+    int WaitEvent(int timeout);
+
+    // stream read into iov, the size or a ChannelStatus. flags apply to the
+    // sockets read by syscall.
+    ssize_t Recv(int fd, iovec* iov, int count, int flags = MSG_DONTWAIT);
+#ifdef __USE_GNU
+    // accept4 of a listener, -1 with EAGAIN when nothing is queued.
+    int Accept(int fd, sockaddr_in* addr, int flags);
+#endif
+
+    inline int GetMaxEvents()
+    {
+        return m_MaxEvents;
+    }
+
+    template<typename DataT>
+    inline bool NextEvent(ServerInterface<DataT>** ppInterface, uint32_t* pEvents)
+    {
+        while(m_Current < m_Ready)
+        {
+            epoll_event& ev = m_pEvents[m_Current++];
+            if(ev.data.ptr == NULL)
+                continue;
+
+            *ppInterface = (ServerInterface<DataT>*)ev.data.ptr;
+            *pEvents = ev.events;
+            return true;
+        }
+        return false;
+    }
+
+    inline void Forget(void* ptr)
+    {
+        for(int i = m_Current; i < m_Ready; ++i)
+        {
+            if(m_pEvents[i].data.ptr == ptr)
+                m_pEvents[i].data.ptr = NULL;
+        }
+    }
+
+private:
+    struct PollEntry
+    {
+        void* Ptr;
+        uint32_t Events;
+        uint32_t Generation;        // of the poll request
+        uint32_t RecvGeneration;    // of the recv or accept request
+        uint32_t Mode;              // 0, RECV or ACCEPT
+        uint32_t ReportBatch;       // the event slot of the fd in a batch
+        int ReportIndex;
+        int RecvError;
+        int AcceptFlags;
+        int PendingHead;            // received buffers, linked by m_BufferNext
+        int PendingTail;
+        uint32_t PendingOffset;
+        bool Active;
+        bool Armed;
+        bool RecvArmed;
+        bool RecvCancelled;         // cancelled, its last completion is due
+        bool Eof;
+        bool Fixed;
+        bool Listed;
+        bool NewData;
+    };
+
+    io_uring_sqe* GetSqe();
+    void PrepPollAdd(int fd);
+    void PrepPollRemove(int fd);
+    void PrepRecv(int fd);
+    void PrepCancel(int fd);
+    int Enter(uint32_t submit, uint32_t wait, int timeout);
+    int Harvest();
+    void Complete(uint32_t type, uint32_t gen, uint32_t fd, int res, uint32_t flags);
+    void Collect();
+    bool AddEvent(int fd, uint32_t events);
+
+    int Register(uint32_t op, void* arg, uint32_t count);
+    void SetupBuffers();
+    void SetupFiles();
+    bool UpdateFile(int fd, int file);
+    void RecycleBuffer(int bid);
+    void DropPending(int fd);
+
+    inline bool HasPending(int fd)
+    {
+        PollEntry& entry = m_Entries[fd];
+        if(entry.Mode == ACCEPT)
+        {
+            std::map<int, std::deque<int> >::iterator iter = m_AcceptQueues.find(fd);
+            return (iter != m_AcceptQueues.end() && !iter->second.empty());
+        }
+        return (entry.PendingHead != -1 || entry.Eof || entry.RecvError != 0);
+    }
+
+    int m_RingFd;
+    int m_MaxEvents;
+    int m_Ready;
+    int m_Current;
+    epoll_event* m_pEvents;
+
+    void* m_pSqRing;
+    void* m_pCqRing;
+    size_t m_SqRingSize;
+    size_t m_CqRingSize;
+    io_uring_sqe* m_pSqes;
+    size_t m_SqesSize;
+
+    uint32_t* m_pSqHead;
+    uint32_t* m_pSqTail;
+    uint32_t m_SqMask;
+    uint32_t m_SqEntries;
+    uint32_t m_SqLocalTail;
+
+    uint32_t* m_pCqHead;
+    uint32_t* m_pCqTail;
+    uint32_t m_CqMask;
+    io_uring_cqe* m_pCqes;
+
+    std::vector<PollEntry> m_Entries;
+    std::vector<int> m_RearmList;
+    std::vector<int> m_RecvRearmList;
+    std::vector<int> m_CompletionList;
+    std::map<int, std::deque<int> > m_AcceptQueues;
+    uint32_t m_Batch;
+
+    io_uring_buf_ring* m_pBufRing;
+    char* m_pBuffers;
+    uint16_t m_BufTail;
+    uint32_t m_FreeBuffers;
+    std::vector<int> m_BufferNext;
+    std::vector<uint32_t> m_BufferLength;
+
+    uint32_t m_FileTableSize;
+    bool m_bRecvMultishot;
+    bool m_bAcceptMultishot;
+};
+
+#endif // define __IOURING_HPP__
+
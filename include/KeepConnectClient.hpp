@@ -82,96 +82,111 @@ class KeepConnectClient :
     public TcpClient<ServerImplT, ChannelDataT, CacheSize>
 {
 public:
-    typedef Channel<ChannelDataT> ChannelType;
+    typedef typename TcpClient<ServerImplT, ChannelDataT, CacheSize>::ChannelType ChannelType;
 
     int Connect(sockaddr_in& addr)
     {
-        if(TcpClient<ServerImplT, ChannelDataT>::Connect(addr) != 0)
+        if(TcpClient<ServerImplT, ChannelDataT, CacheSize>::Connect(addr) != 0)
             return -1;
+        return KeepAlive();
+    }
 
-        int keepalive = 1;
-        if(setsockopt(this->m_ServerInterface.m_Channel.Socket, SOL_SOCKET, SO_KEEPALIVE, &keepalive, sizeof(int)) == -1)
-        {
-            this->Disconnect();
+    int AsyncConnect(sockaddr_in& addr)
+    {
+        if(TcpClient<ServerImplT, ChannelDataT, CacheSize>::AsyncConnect(addr) != 0)
             return -1;
-        }
-        return 0;
+        return KeepAlive();
     }
 
-    void OnReadable(ServerInterface<ChannelDataT>* pInterface)
+    void OnReadable(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
     {
-        int dwRemainSize = CacheSize - this->m_dwAvailableSize;
-        if(dwRemainSize <= 0)
-        {
-            this->Disconnect();
-
-            m_Policy.OnDisconnected();
-            m_TimeoutID = PoolObject<Timer<void, TimerInterval> >::Instance().SetTimeout(
-                                boost::bind(&KeepConnectClient<ServerImplT, ChannelDataT, CacheSize,
-                                             PolicyT, TimerInterval>::OnConnectTimeout, this), 
-                                m_Policy.GetTimeout());
-
-            throw InternalException((boost::format("[%s:%d][error] package cache is full.") % __FILE__ % __LINE__).str().c_str());
-        }
-
-        IOBuffer ioRecvBuffer(&this->m_cPackageCache[this->m_dwAvailableSize], dwRemainSize);
-        pInterface->m_Channel >> ioRecvBuffer;
+        TcpClient<ServerImplT, ChannelDataT, CacheSize>::OnReadable(pInterface);
+        if(pInterface->m_Channel.Socket == -1)
+            OnConnectionLost();
+    }
 
-        if(ioRecvBuffer.GetReadSize() == 0)
+    // the result of a connect in progress, a failed one is retried.
+    void OnWriteable(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
+    {
+        TcpClient<ServerImplT, ChannelDataT, CacheSize>::OnWriteable(pInterface);
+        if(pInterface->m_Channel.Socket == -1)
         {
-            this->Disconnect();
-
-            m_Policy.OnDisconnected();
-            m_TimeoutID = PoolObject<Timer<void, TimerInterval> >::Instance().SetTimeout(
-                                boost::bind(&KeepConnectClient<ServerImplT, ChannelDataT, CacheSize,
-                                             PolicyT, TimerInterval>::OnConnectTimeout, this), 
-                                m_Policy.GetTimeout());
+            m_Policy.OnTimeout();
+            ScheduleReconnect();
         }
-        else
-        {
-            this->m_dwAvailableSize += ioRecvBuffer.GetReadSize();
+    }
+
+    void OnAsyncConnectTimout()
+    {
+        TcpClient<ServerImplT, ChannelDataT, CacheSize>::OnAsyncConnectTimout();
 
-            IOBuffer in(this->m_cPackageCache, this->m_dwAvailableSize, this->m_dwAvailableSize);
-            this->OnMessage(pInterface->m_Channel, in);
+        m_Policy.OnTimeout();
+        ScheduleReconnect();
+    }
 
-            this->m_dwAvailableSize = in.GetReadSize() - in.GetReadPosition();
-            if(in.GetReadPosition() > 0 && this->m_dwAvailableSize > 0)
-                memmove(this->m_cPackageCache, &this->m_cPackageCache[in.GetReadPosition()], this->m_dwAvailableSize);
-        }
+    void OnConnectionLost()
+    {
+        m_Policy.OnDisconnected();
+        ScheduleReconnect();
     }
 
-    void OnErrorable(ServerInterface<ChannelDataT>* pInterface)
+    void OnErrorable(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
     {
-        this->OnError(pInterface->m_Channel);
-        this->Disconnect();
+        TcpClient<ServerImplT, ChannelDataT, CacheSize>::OnErrorable(pInterface);
 
         m_Policy.OnError();
-        PoolObject<Timer<void, TimerInterval> >::Instance().Clear(m_TimeoutID);
-        m_TimeoutID = PoolObject<Timer<void> >::Instance().SetTimeout(
-                            boost::bind(&KeepConnectClient<ServerImplT, ChannelDataT, CacheSize, 
-                                        PolicyT, TimerInterval>::OnConnectTimeout, this), 
-                            m_Policy.GetTimeout());
+        ScheduleReconnect();
     }
 
     void OnConnectTimeout()
     {
-        if(!this->IsConnected() && this->Reconnect() != 0)
+        m_TimeoutID = 0;
+        if(this->IsConnected() || this->IsConnecting())
+            return;
+
+        // reconnects do not hold the event loop.
+        this->Disconnect();
+        if(AsyncConnect(this->m_ServerInterface.m_Channel.Address) != 0)
         {
             m_Policy.OnTimeout();
-            m_TimeoutID = PoolObject<Timer<void, TimerInterval> >::Instance().SetTimeout(
-                            boost::bind(&KeepConnectClient<ServerImplT, ChannelDataT, CacheSize, 
-                                        PolicyT, TimerInterval>::OnConnectTimeout, this), 
-                            m_Policy.GetTimeout());
+            ScheduleReconnect();
         }
     }
 
-    KeepConnectClient()
+    KeepConnectClient() :
+        m_TimeoutID(0)
     {
     }
 
 protected:
     PolicyT m_Policy;
     typename Timer<void, TimerInterval>::TimerID m_TimeoutID;
+
+    // one reconnect is scheduled at a time, a later failure replaces it.
+    void ScheduleReconnect()
+    {
+        if(m_TimeoutID != 0)
+            PoolObject<Timer<void, TimerInterval> >::Instance().Clear(m_TimeoutID);
+
+        m_TimeoutID = PoolObject<Timer<void, TimerInterval> >::Instance().SetTimeout(
+                        boost::bind(&KeepConnectClient<ServerImplT, ChannelDataT, CacheSize, PolicyT, TimerInterval>::OnConnectTimeout, this), 
+                        m_Policy.GetTimeout());
+    }
+
+    int KeepAlive()
+    {
+        // the connect may have failed and closed the socket already.
+        if(this->m_ServerInterface.m_Channel.Socket == -1)
+            return -1;
+
+        int keepalive = 1;
+        if(setsockopt(this->m_ServerInterface.m_Channel.Socket, SOL_SOCKET, SO_KEEPALIVE, &keepalive, sizeof(int)) == -1)
+        {
+            this->Disconnect();
+            return -1;
+        }
+        return 0;
+    }
 };
 
 
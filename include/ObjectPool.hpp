@@ -0,0 +1,166 @@
+/*++
+ *
+ * Simple Server Library
+ * Author: NickeyWoo
+ * Date: 2026-10-17
+ *
+--*/
+#ifndef __OBJECTPOOL_HPP__
+#define __OBJECTPOOL_HPP__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <new>
+#include <utility>
+#include <vector>
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <boost/format.hpp>
+#include "PoolObject.hpp"
+
+#ifndef OBJECTPOOL_SLAB_SIZE
+    // bytes of a slab, a slab holds at least one object
+    #define OBJECTPOOL_SLAB_SIZE        1048576
+#endif
+
+//
+// per worker slab allocator of fixed size objects, use
+// PoolObject<ObjectPool<T> >::Instance(). objects are carved out of slabs
+// and go back to a free list on Free, slabs are kept until the pool is
+// destroyed.
+//
+template<typename ObjectT>
+class ObjectPool :
+    public boost::noncopyable
+{
+public:
+    ObjectPool() :
+        m_pFreeList(NULL),
+        m_FreeCount(0),
+        m_UsedCount(0),
+        m_PeakUsedCount(0),
+        m_AllocCount(0),
+        m_HitCount(0)
+    {
+    }
+
+    ~ObjectPool()
+    {
+        for(typename std::vector<char*>::iterator iter = m_SlabList.begin();
+            iter != m_SlabList.end();
+            ++iter)
+        {
+            free(*iter);
+        }
+    }
+
+    // a default constructed object, NULL if no slab can be allocated.
+    ObjectT* Alloc()
+    {
+        if(m_pFreeList)
+            ++m_HitCount;
+        else if(!AllocSlab())
+            return NULL;
+
+        FreeNode* pNode = m_pFreeList;
+        m_pFreeList = pNode->pNext;
+        --m_FreeCount;
+
+        ++m_AllocCount;
+        ++m_UsedCount;
+        if(m_UsedCount > m_PeakUsedCount)
+            m_PeakUsedCount = m_UsedCount;
+
+        return new((void*)pNode) ObjectT();
+    }
+
+    void Free(ObjectT* pObject)
+    {
+        if(!pObject)
+            return;
+
+        pObject->~ObjectT();
+
+        FreeNode* pNode = reinterpret_cast<FreeNode*>(pObject);
+        pNode->pNext = m_pFreeList;
+        m_pFreeList = pNode;
+        ++m_FreeCount;
+        --m_UsedCount;
+    }
+
+    inline uint32_t GetObjectsPerSlab()
+    {
+        return (OBJECTPOOL_SLAB_SIZE / GetObjectSize() == 0) ? 1 : OBJECTPOOL_SLAB_SIZE / GetObjectSize();
+    }
+
+    inline uint64_t GetUsedCount()
+    {
+        return m_UsedCount;
+    }
+
+    void Dump(std::string& strDump)
+    {
+        uint64_t total = m_UsedCount + m_FreeCount;
+        strDump.append((boost::format("Object Size: %lu bytes, %u per slab\n")
+                            % (uint64_t)GetObjectSize() % GetObjectsPerSlab()).str());
+        strDump.append((boost::format("Slabs: %lu, %lu bytes\n")
+                            % (uint64_t)m_SlabList.size() % (total * GetObjectSize())).str());
+        strDump.append((boost::format("Objects In Use: %lu/%lu, %.02f%%, peak %lu\n")
+                            % m_UsedCount % total % (total ? (double)m_UsedCount * 100 / total : 0) % m_PeakUsedCount).str());
+        strDump.append((boost::format("Allocs: %lu, %.02f%% from free list\n")
+                            % m_AllocCount % (m_AllocCount ? (double)m_HitCount * 100 / m_AllocCount : 0)).str());
+    }
+
+    inline void Dump()
+    {
+        std::string strDump;
+        Dump(strDump);
+        printf("%s", strDump.c_str());
+    }
+
+private:
+    struct FreeNode
+    {
+        FreeNode* pNext;
+    };
+
+    static inline size_t GetObjectSize()
+    {
+        // keep every object aligned like malloc would.
+        size_t size = (sizeof(ObjectT) < sizeof(FreeNode)) ? sizeof(FreeNode) : sizeof(ObjectT);
+        return (size + 15) & ~(size_t)15;
+    }
+
+    bool AllocSlab()
+    {
+        uint32_t count = GetObjectsPerSlab();
+        char* pSlab = (char*)malloc(count * GetObjectSize());
+        if(!pSlab)
+            return false;
+
+        m_SlabList.push_back(pSlab);
+
+        // thread the new objects on the free list, lowest address first.
+        for(uint32_t i = count; i > 0; --i)
+        {
+            FreeNode* pNode = reinterpret_cast<FreeNode*>(pSlab + (i - 1) * GetObjectSize());
+            pNode->pNext = m_pFreeList;
+            m_pFreeList = pNode;
+        }
+        m_FreeCount += count;
+        return true;
+    }
+
+    std::vector<char*> m_SlabList;
+    FreeNode* m_pFreeList;
+
+    uint64_t m_FreeCount;
+    uint64_t m_UsedCount;
+    uint64_t m_PeakUsedCount;
+    uint64_t m_AllocCount;
+    uint64_t m_HitCount;
+};
+
+#endif // define __OBJECTPOOL_HPP__
+
@@ -71,12 +71,48 @@ public:
             return PoolObject<EventScheduler>::Instance().GetIdleTimeout();
     }
 
+    inline int SetMaxEvents(int maxEvents)
+    {
+        int old = m_MaxEvents;
+        m_MaxEvents = maxEvents;
+        return old;
+    }
+
+    inline int GetMaxEvents()
+    {
+        return m_MaxEvents;
+    }
+
+    inline int SetBusyPoll(int spinTime, int socketBusyPoll = 0)
+    {
+        if(!m_bStartup)
+        {
+            int old = m_BusyPollTime;
+            m_BusyPollTime = spinTime;
+            m_SocketBusyPoll = socketBusyPoll;
+            return old;
+        }
+        else
+            return PoolObject<EventScheduler>::Instance().SetBusyPoll(spinTime, socketBusyPoll);
+    }
+
+    inline int GetBusyPoll()
+    {
+        if(!m_bStartup)
+            return m_BusyPollTime;
+        else
+            return PoolObject<EventScheduler>::Instance().GetBusyPoll();
+    }
+
 protected:
     ProcessPool();
 
     bool m_bStartup;
     uint32_t m_id;
     int m_IdleTimeout;
+    int m_MaxEvents;
+    int m_BusyPollTime;
+    int m_SocketBusyPoll;
     std::list<boost::function<bool(void)> > m_StartupCallbackList;
 };
 
@@ -126,14 +162,64 @@ public:
             return PoolObject<EventScheduler>::Instance().GetIdleTimeout();
     }
 
+    inline int SetMaxEvents(int maxEvents)
+    {
+        int old = m_MaxEvents;
+        m_MaxEvents = maxEvents;
+        return old;
+    }
+
+    inline int GetMaxEvents()
+    {
+        return m_MaxEvents;
+    }
+
+    inline int SetBusyPoll(int spinTime, int socketBusyPoll = 0)
+    {
+        if(!m_bStartup)
+        {
+            int old = m_BusyPollTime;
+            m_BusyPollTime = spinTime;
+            m_SocketBusyPoll = socketBusyPoll;
+            return old;
+        }
+        else
+            return PoolObject<EventScheduler>::Instance().SetBusyPoll(spinTime, socketBusyPoll);
+    }
+
+    inline int GetBusyPoll()
+    {
+        if(!m_bStartup)
+            return m_BusyPollTime;
+        else
+            return PoolObject<EventScheduler>::Instance().GetBusyPoll();
+    }
+
     uint32_t GetID();
 
+    inline uint32_t GetConcurrency()
+    {
+        return m_SchedulerList.size();
+    }
+
+    // the scheduler of worker id, use Post to hand it work from another thread.
+    inline EventScheduler* GetScheduler(uint32_t id)
+    {
+        if(id >= m_SchedulerList.size())
+            return NULL;
+        return __sync_fetch_and_add(&m_SchedulerList[id], 0);
+    }
+
 protected:
     ThreadPool();
     static void* ThreadProc(void* paramenter);
 
+    std::vector<EventScheduler*> m_SchedulerList;
     bool m_bStartup;
     int m_IdleTimeout;
+    int m_MaxEvents;
+    int m_BusyPollTime;
+    int m_SocketBusyPoll;
     std::list<boost::function<bool(void)> > m_StartupCallbackList;
 };
 
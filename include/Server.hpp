@@ -18,28 +18,110 @@
 #include "Channel.hpp"
 #include "Log.hpp"
 
+#ifndef SERVER_WAKEUP_BUDGET
+    // max reads or accepts per wakeup in edge-triggered mode
+    #define SERVER_WAKEUP_BUDGET    16
+#endif
+
+#ifndef SERVER_BYTE_BUDGET
+    // max bytes read from one connection per wakeup in edge-triggered mode
+    #define SERVER_BYTE_BUDGET      262144
+#endif
+
+template<typename ChannelDataT>
+class ServerInterface;
+
+struct ServerDispatchTable
+{
+    void (*Readable)(void* pHandler, void* pInterface);
+    void (*Writeable)(void* pHandler, void* pInterface);
+    void (*Error)(void* pHandler, void* pInterface);
+};
+
+//
+// compile-time dispatch to ServerImplT::OnReadable/OnWriteable/OnErrorable,
+// one static table per handler type, the interface only keeps the handler
+// pointer and the table.
+//
+template<typename ServerImplT, typename ChannelDataT>
+struct ServerDispatcher
+{
+    static void OnReadable(void* pHandler, void* pInterface)
+    {
+        static_cast<ServerImplT*>(pHandler)->OnReadable(static_cast<ServerInterface<ChannelDataT>*>(pInterface));
+    }
+
+    static void OnWriteable(void* pHandler, void* pInterface)
+    {
+        static_cast<ServerImplT*>(pHandler)->OnWriteable(static_cast<ServerInterface<ChannelDataT>*>(pInterface));
+    }
+
+    static void OnErrorable(void* pHandler, void* pInterface)
+    {
+        static_cast<ServerImplT*>(pHandler)->OnErrorable(static_cast<ServerInterface<ChannelDataT>*>(pInterface));
+    }
+
+    static const ServerDispatchTable Table;
+};
+
+template<typename ServerImplT, typename ChannelDataT>
+const ServerDispatchTable ServerDispatcher<ServerImplT, ChannelDataT>::Table = {
+    &ServerDispatcher<ServerImplT, ChannelDataT>::OnReadable,
+    &ServerDispatcher<ServerImplT, ChannelDataT>::OnWriteable,
+    &ServerDispatcher<ServerImplT, ChannelDataT>::OnErrorable
+};
+
 template<typename ChannelDataT>
 class ServerInterface
 {
 public:
+    ServerInterface() :
+        m_pHandler(NULL),
+        m_pDispatchTable(NULL),
+        m_bReady(false),
+        m_bFlush(false)
+    {
+    }
+
+    // static dispatch, takes precedence over the callbacks.
+    template<typename ServerImplT>
+    inline void SetHandler(ServerImplT* pHandler)
+    {
+        m_pHandler = pHandler;
+        m_pDispatchTable = &ServerDispatcher<ServerImplT, ChannelDataT>::Table;
+    }
+
     inline void OnWriteable()
     {
-        m_WriteableCallback(this);
+        if(m_pDispatchTable)
+            m_pDispatchTable->Writeable(m_pHandler, this);
+        else
+            m_WriteableCallback(this);
     }
 
     inline void OnReadable()
     {
-        m_ReadableCallback(this);
+        if(m_pDispatchTable)
+            m_pDispatchTable->Readable(m_pHandler, this);
+        else
+            m_ReadableCallback(this);
     }
 
     inline void OnError()
     {
-        m_ErrorCallback(this);
+        if(m_pDispatchTable)
+            m_pDispatchTable->Error(m_pHandler, this);
+        else if(m_ErrorCallback)
+            m_ErrorCallback(this);
     }
     
     boost::function<void(ServerInterface<ChannelDataT>*)> m_ReadableCallback;
     boost::function<void(ServerInterface<ChannelDataT>*)> m_WriteableCallback;
     boost::function<void(ServerInterface<ChannelDataT>*)> m_ErrorCallback;
+    void* m_pHandler;
+    const ServerDispatchTable* m_pDispatchTable;
+    bool m_bReady;
+    bool m_bFlush;
     Channel<ChannelDataT> m_Channel;
 };
 
@@ -53,5 +135,6 @@ ServerInterface<ChannelDataT>* GetServerInterface(Channel<ChannelDataT>* pstChan
 }
 
 int SetCloexecFd(int fd, int flags = FD_CLOEXEC);
+int SetNonblockFd(int fd);
 
 #endif // define __SERVER_HPP__
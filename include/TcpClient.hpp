@@ -20,49 +20,23 @@
 #include "Clock.hpp"
 #include "TcpServer.hpp"
 
+#ifndef TCPCLIENT_CONNECT_TIMEOUT
+    // milliseconds until a connect in progress fails
+    #define TCPCLIENT_CONNECT_TIMEOUT       3000
+#endif
+
 template<typename ServerImplT, typename ChannelDataT = void, uint32_t CacheSize = 65535>
 class TcpClient
 {
 public:
     typedef Channel<TcpChannelCache<ChannelDataT, CacheSize> > ChannelType;
 
-    int Connect(sockaddr_in& addr)
+    // connect and wait for it up to the connect timeout, 0 once connected.
+    // the thread is held while the connect is in progress, so it is refused
+    // in the event loop thread, use AsyncConnect there.
+    inline int Connect(sockaddr_in& addr)
     {
-        if(m_ServerInterface.m_Channel.Socket == -1)
-        {
-#ifdef __USE_GNU
-            m_ServerInterface.m_Channel.Socket = socket(PF_INET, SOCK_STREAM|SOCK_CLOEXEC, 0);
-            if(m_ServerInterface.m_Channel.Socket == -1)
-                return -1;
-#else
-            m_ServerInterface.m_Channel.Socket = socket(PF_INET, SOCK_STREAM, 0);
-            if(m_ServerInterface.m_Channel.Socket == -1)
-                return -1;
-
-            if(SetCloexecFd(m_ServerInterface.m_Channel.Socket) < 0)
-            {
-                close(m_ServerInterface.m_Channel.Socket);
-                m_ServerInterface.m_Channel.Socket = -1;
-                return -1;
-            }
-#endif
-        }
-
-        memcpy(&m_ServerInterface.m_Channel.Address, &addr, sizeof(sockaddr_in));
-        if(connect(m_ServerInterface.m_Channel.Socket, (sockaddr*)&addr, sizeof(sockaddr_in)) == -1)
-            return -1;
-
-        m_ServerInterface.m_Channel.Data.dwCacheAvailableSize = 0;
-
-        this->OnConnected(m_ServerInterface.m_Channel);
-
-        if(Pool::Instance().IsStartup())
-        {
-            EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
-            return scheduler.Register(this, EventScheduler::PollType::IN);
-        }
-        else
-            return 0;
+        return StartConnect(addr, m_dwConnectTimeout, true);
     }
 
     int Connect(sockaddr_in& addr, timeval* timeout)
@@ -70,73 +44,22 @@ public:
         if(timeout == NULL)
             return -1;
 
-        if(m_ServerInterface.m_Channel.Socket == -1)
-        {
-#ifdef __USE_GNU
-            m_ServerInterface.m_Channel.Socket = socket(PF_INET, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0);
-            if(m_ServerInterface.m_Channel.Socket == -1)
-                return -1;
-#else
-            m_ServerInterface.m_Channel.Socket = socket(PF_INET, SOCK_STREAM, 0);
-            if(m_ServerInterface.m_Channel.Socket == -1)
-                return -1;
-
-            if(SetCloexecFd(m_ServerInterface.m_Channel.Socket, FD_CLOEXEC | O_NONBLOCK) < 0)
-            {
-                close(m_ServerInterface.m_Channel.Socket);
-                m_ServerInterface.m_Channel.Socket = -1;
-                return -1;
-            }
-#endif
-        }
-
-        memcpy(&m_ServerInterface.m_Channel.Address, &addr, sizeof(sockaddr_in));
-        if(connect(m_ServerInterface.m_Channel.Socket, (sockaddr*)&addr, sizeof(sockaddr_in)) == -1 && 
-           errno != EINPROGRESS)
-            return -1;
-
-        m_ServerInterface.m_Channel.Data.dwCacheAvailableSize = 0;
-
-        EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
-        if(Pool::Instance().IsStartup())
-        {
-            m_AsyncConnectTimerId = PoolObject<Timer<void> >::Instance().SetTimeout(
-                                        boost::bind(&ServerImplT::OnAsyncConnectTimout, this), 
-                                        (timeout->tv_sec*1000 + timeout->tv_usec/1000));
-            return scheduler.Register(this, EventScheduler::PollType::OUT);
-        }
-        else
-        {
-            int iRet = scheduler.Wait(&m_ServerInterface, EventScheduler::PollType::OUT, timeout);
-            if(iRet == -1)
-                return -1;
+        return StartConnect(addr, timeout->tv_sec*1000 + timeout->tv_usec/1000, true);
+    }
 
-            if(iRet == 0)
-            {
-                this->OnConnectTimout(m_ServerInterface.m_Channel);
-                Disconnect();
-            }
-            else
-            {
-                int errinfo;
-                socklen_t errlen;
-                if(-1 == getsockopt(m_ServerInterface.m_Channel.Socket, SOL_SOCKET, SO_ERROR, &errinfo, &errlen) ||
-                   errinfo != 0)
-                {
-                    this->OnConnectTimout(m_ServerInterface.m_Channel);
-                    Disconnect();
-                }
-                else
-                    this->OnConnected(m_ServerInterface.m_Channel);
-            }
-        }
-        return 0;
+    // start a non-blocking connect, 0 if it is in progress or done. in the
+    // event loop OnConnected or OnConnectTimout tells the result, before the
+    // pool starts the connect is waited for like by Connect.
+    inline int AsyncConnect(sockaddr_in& addr)
+    {
+        return StartConnect(addr, m_dwConnectTimeout, false);
     }
 
     inline void Close()
     {
         close(m_ServerInterface.m_Channel.Socket);
         m_ServerInterface.m_Channel.Socket = -1;
+        m_bConnected = false;
     }
 
     void Disconnect()
@@ -146,8 +69,14 @@ public:
             PoolObject<Timer<void> >::Instance().Clear(m_AsyncConnectTimerId);
             m_AsyncConnectTimerId = 0;
         }
+        m_bConnecting = false;
 
-        this->OnDisconnected(m_ServerInterface.m_Channel);
+        // OnDisconnected only pairs with OnConnected.
+        if(m_bConnected)
+        {
+            m_bConnected = false;
+            this->OnDisconnected(m_ServerInterface.m_Channel);
+        }
 
         if(Pool::Instance().IsStartup())
             PoolObject<EventScheduler>::Instance().UnRegister(this);
@@ -158,83 +87,162 @@ public:
 
     void OnWriteable(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
     {
-        int errinfo;
-        socklen_t errlen;
-        if(-1 == getsockopt(pInterface->m_Channel.Socket, SOL_SOCKET, SO_ERROR, &errinfo, &errlen) ||
-           errinfo != 0)
+        if(!m_bConnecting)
+            return;
+
+        if(GetConnectError() != 0)
         {
             this->OnConnectTimout(pInterface->m_Channel);
             Disconnect();
         }
         else
-        {
-            PoolObject<Timer<void> >::Instance().Clear(m_AsyncConnectTimerId);
-            m_AsyncConnectTimerId = 0;
-
-            this->OnConnected(pInterface->m_Channel);
-            PoolObject<EventScheduler>::Instance().Update(this, EventScheduler::PollType::IN);
-        }
+            CompleteConnect();
     }
 
     void OnReadable(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
     {
-        int dwRemainSize = CacheSize - pInterface->m_Channel.Data.dwCacheAvailableSize;
-        if(dwRemainSize <= 0)
+        if(!(m_dwEventFlags & EventScheduler::PollType::ET))
         {
-            Disconnect();
+            ReadServer(pInterface);
+            return;
+        }
 
-            throw InternalException((boost::format("[%s:%d][error] package cache is full.") % __FILE__ % __LINE__).str().c_str());
+        // edge-triggered, read until EAGAIN or the wakeup budget is used up.
+        for(uint32_t i = 0; i < m_dwWakeupBudget; ++i)
+        {
+            if(ReadServer(pInterface) <= 0)
+                return;
         }
 
-        IOBuffer ioRecvBuffer(&pInterface->m_Channel.Data.cPackageCache[pInterface->m_Channel.Data.dwCacheAvailableSize], 
-                              dwRemainSize);
-        pInterface->m_Channel >> ioRecvBuffer;
+        PoolObject<EventScheduler>::Instance().SetReady(pInterface);
+    }
+
+    // return 1 if data was read, 0 on EAGAIN, -1 if the connection is closed.
+    // failures close the connection without an exception.
+    int ReadServer(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
+    {
+        TcpChannelCache<ChannelDataT, CacheSize>& cache = pInterface->m_Channel.Data;
+        if(cache.dwCacheAvailableSize >= CacheSize)
+            return FailServer(pInterface);
+
+        // bytes beyond the free space of the cache land in the stack buffer
+        // and are fed in as OnMessage releases space.
+        char cOverflow[SERVER_RECV_OVERFLOW_SIZE];
+        uint32_t dwFreeSize = CacheSize - cache.dwCacheAvailableSize;
+
+        ssize_t recvSize = TcpRecvCache::Recv(pInterface->m_Channel.Socket, cache.cPackageCache, CacheSize,
+                                              cache.dwCacheAvailableSize, cOverflow, SERVER_RECV_OVERFLOW_SIZE);
+        if(recvSize == CHANNEL_AGAIN)
+            return 0;
 
-        if(ioRecvBuffer.GetReadSize() == 0)
+        if(recvSize < 0)
         {
+            if(recvSize == CHANNEL_ERROR)
+                this->OnError(pInterface->m_Channel);
             Disconnect();
+            return -1;
         }
-        else
+
+        uint32_t dwOverflowSize = ((uint32_t)recvSize > dwFreeSize) ? recvSize - dwFreeSize : 0;
+        uint32_t dwOverflowPosition = 0;
+        cache.dwCacheAvailableSize += recvSize - dwOverflowSize;
+
+        while(true)
         {
-            pInterface->m_Channel.Data.dwCacheAvailableSize += ioRecvBuffer.GetReadSize();
+            int consumeSize = DeliverServer(pInterface);
+            if(consumeSize == -1)
+                return -1;
 
-            IOBuffer in(pInterface->m_Channel.Data.cPackageCache, 
-                        pInterface->m_Channel.Data.dwCacheAvailableSize,
-                        pInterface->m_Channel.Data.dwCacheAvailableSize);
-            this->OnMessage(pInterface->m_Channel, in);
+            if(dwOverflowPosition == dwOverflowSize)
+                return 1;
 
-            pInterface->m_Channel.Data.dwCacheAvailableSize = in.GetReadSize() - in.GetReadPosition();
-            if(in.GetReadPosition() > 0 && pInterface->m_Channel.Data.dwCacheAvailableSize > 0)
-            {
-                memmove(pInterface->m_Channel.Data.cPackageCache, 
-                        &pInterface->m_Channel.Data.cPackageCache[in.GetReadPosition()],
-                        pInterface->m_Channel.Data.dwCacheAvailableSize);
-            }
+            if(consumeSize == 0)
+                return FailServer(pInterface);
+
+            dwOverflowPosition += TcpRecvCache::Append(cache.cPackageCache, CacheSize, cache.dwCacheAvailableSize,
+                                                       &cOverflow[dwOverflowPosition], dwOverflowSize - dwOverflowPosition);
         }
     }
 
-    void OnErrorable(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
+    // OnMessage on the unread bytes, what it left is moved to the front.
+    // return the consumed size, -1 if the connection is closed.
+    int DeliverServer(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
+    {
+        TcpChannelCache<ChannelDataT, CacheSize>& cache = pInterface->m_Channel.Data;
+
+        IOBuffer in(cache.cPackageCache, cache.dwCacheAvailableSize, cache.dwCacheAvailableSize);
+        this->OnMessage(pInterface->m_Channel, in);
+
+        // OnMessage may close the connection.
+        if(pInterface->m_Channel.Socket == -1)
+            return -1;
+
+        TcpRecvCache::Consume(cache.cPackageCache, cache.dwCacheAvailableSize, in.GetReadPosition());
+        return in.GetReadPosition();
+    }
+
+    int FailServer(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
     {
+        LOG("[%s:%d] package cache is full, disconnect server.", 
+            inet_ntoa(pInterface->m_Channel.Address.sin_addr), ntohs(pInterface->m_Channel.Address.sin_port));
+
         this->OnError(pInterface->m_Channel);
         Disconnect();
+        return -1;
+    }
+
+    void OnErrorable(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
+    {
+        if(m_bConnecting)
+            this->OnConnectTimout(pInterface->m_Channel);
+        else
+            this->OnError(pInterface->m_Channel);
+        Disconnect();
     }
 
     // tcp client interface
     TcpClient() :
-        m_AsyncConnectTimerId(0)
+        m_AsyncConnectTimerId(0),
+        m_bConnecting(false),
+        m_bConnected(false),
+        m_dwConnectTimeout(TCPCLIENT_CONNECT_TIMEOUT),
+        m_dwEventFlags(0),
+        m_dwWakeupBudget(SERVER_WAKEUP_BUDGET)
     {
         m_ServerInterface.m_Channel.Socket = -1;
         m_ServerInterface.m_Channel.Data.dwCacheAvailableSize = 0;
 
-        m_ServerInterface.m_WriteableCallback = boost::bind(&ServerImplT::OnWriteable, reinterpret_cast<ServerImplT*>(this), _1);
-        m_ServerInterface.m_ReadableCallback = boost::bind(&ServerImplT::OnReadable, reinterpret_cast<ServerImplT*>(this), _1);
-        m_ServerInterface.m_ErrorCallback = boost::bind(&ServerImplT::OnErrorable, reinterpret_cast<ServerImplT*>(this), _1);
+        m_ServerInterface.SetHandler(reinterpret_cast<ServerImplT*>(this));
     }
 
     virtual ~TcpClient()
     {
     }
 
+    // edge-triggered registration, the connected socket is non-blocking and
+    // drained up to budget reads per wakeup.
+    inline void SetEdgeTriggered(bool enable, uint32_t budget = SERVER_WAKEUP_BUDGET)
+    {
+        m_dwEventFlags = enable ? EventScheduler::PollType::ET : 0;
+        m_dwWakeupBudget = (budget == 0) ? 1 : budget;
+    }
+
+    inline uint32_t GetEventFlags()
+    {
+        return m_dwEventFlags;
+    }
+
+    // milliseconds until Connect(addr) fails.
+    inline void SetConnectTimeout(uint32_t timeout)
+    {
+        m_dwConnectTimeout = (timeout == 0) ? 1 : timeout;
+    }
+
+    inline bool IsConnecting()
+    {
+        return m_bConnecting;
+    }
+
     virtual void OnConnectTimout(ChannelType& channel)
     {
     }
@@ -277,26 +285,29 @@ public:
         return Reconnect(m_ServerInterface.m_Channel.Address);
     }
 
+    // disconnect and start a new connect, 0 if it is in progress or done.
+    // OnConnected or OnConnectTimout tells the result like AsyncConnect.
     int Reconnect(sockaddr_in& addr)
     {
         Disconnect();
 
-        if(Connect(addr) != 0)
+        if(AsyncConnect(addr) != 0)
             return -1;
 
         return 0;
     }
 
+    // the sent size, or a ChannelStatus.
     inline ssize_t Send(IOBuffer& out)
     {
-        return send(m_ServerInterface.m_Channel.Socket, 
-                    out.GetWriteBuffer(), out.GetWriteSize(), 0);
+        return ChannelSend(m_ServerInterface.m_Channel.Socket, 
+                           out.GetWriteBuffer(), out.GetWriteSize(), MSG_NOSIGNAL);
     }
 
+    // the read size, or a ChannelStatus.
     inline ssize_t Recv(IOBuffer& in)
     {
-        m_ServerInterface.m_Channel >> in;
-        return in.GetReadSize();
+        return ReadChannel(m_ServerInterface.m_Channel, in);
     }
 
     inline int Shutdown(int how)
@@ -311,8 +322,149 @@ public:
         Disconnect();
     }
 
+    int StartConnect(sockaddr_in& addr, uint32_t timeout, bool wait)
+    {
+        if(timeout == 0)
+            timeout = 1;
+
+        if(wait && PoolObject<EventScheduler>::Instance().IsInLoopThread())
+        {
+            LOG("[%s:%d] blocking connect in the event loop, use AsyncConnect.",
+                inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+
+            errno = EWOULDBLOCK;
+            return -1;
+        }
+
+        // a connect in progress is left to finish, or waited for.
+        if(m_bConnecting)
+            return wait ? WaitConnect(timeout) : 0;
+
+        if(m_ServerInterface.m_Channel.Socket == -1)
+        {
+#ifdef __USE_GNU
+            m_ServerInterface.m_Channel.Socket = socket(PF_INET, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0);
+            if(m_ServerInterface.m_Channel.Socket == -1)
+                return -1;
+#else
+            m_ServerInterface.m_Channel.Socket = socket(PF_INET, SOCK_STREAM, 0);
+            if(m_ServerInterface.m_Channel.Socket == -1)
+                return -1;
+
+            if(SetCloexecFd(m_ServerInterface.m_Channel.Socket) < 0 || SetNonblockFd(m_ServerInterface.m_Channel.Socket) < 0)
+            {
+                close(m_ServerInterface.m_Channel.Socket);
+                m_ServerInterface.m_Channel.Socket = -1;
+                return -1;
+            }
+#endif
+        }
+        else if(SetNonblockFd(m_ServerInterface.m_Channel.Socket) < 0)
+            return -1;
+
+        memcpy(&m_ServerInterface.m_Channel.Address, &addr, sizeof(sockaddr_in));
+        m_ServerInterface.m_Channel.Data.dwCacheAvailableSize = 0;
+
+        if(connect(m_ServerInterface.m_Channel.Socket, (sockaddr*)&addr, sizeof(sockaddr_in)) == 0)
+            return CompleteConnect();
+
+        if(errno != EINPROGRESS)
+            return -1;
+
+        if(!wait && Pool::Instance().IsStartup())
+        {
+            EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
+            m_AsyncConnectTimerId = PoolObject<Timer<void> >::Instance().SetTimeout(
+                                        boost::bind(&ServerImplT::OnAsyncConnectTimout, reinterpret_cast<ServerImplT*>(this)), timeout);
+            m_bConnecting = true;
+            if(scheduler.Register(this, EventScheduler::PollType::OUT) != 0)
+            {
+                PoolObject<Timer<void> >::Instance().Clear(m_AsyncConnectTimerId);
+                m_AsyncConnectTimerId = 0;
+                m_bConnecting = false;
+                return -1;
+            }
+            return 0;
+        }
+        return WaitConnect(timeout);
+    }
+
+    // poll the connect in progress for up to timeout milliseconds.
+    int WaitConnect(uint32_t timeout)
+    {
+        timeval tv;
+        tv.tv_sec = timeout / 1000;
+        tv.tv_usec = (timeout % 1000) * 1000;
+
+        int iRet = PoolObject<EventScheduler>::Instance().Wait(&m_ServerInterface, EventScheduler::PollType::OUT, &tv);
+        if(iRet == -1)
+            return -1;
+
+        if(iRet == 0 || GetConnectError() != 0)
+        {
+            this->OnConnectTimout(m_ServerInterface.m_Channel);
+            Disconnect();
+            return -1;
+        }
+        return CompleteConnect();
+    }
+
+    // level-triggered clients get back the blocking socket of a plain
+    // connect, Send and Recv block as before.
+    int CompleteConnect()
+    {
+        int fd = m_ServerInterface.m_Channel.Socket;
+        if(!(m_dwEventFlags & EventScheduler::PollType::ET))
+        {
+            int fl = fcntl(fd, F_GETFL, 0);
+            if(fl == -1 || fcntl(fd, F_SETFL, fl & ~O_NONBLOCK) == -1)
+            {
+                this->OnConnectTimout(m_ServerInterface.m_Channel);
+                Disconnect();
+                return -1;
+            }
+        }
+
+        bool bConnecting = m_bConnecting;
+        if(m_AsyncConnectTimerId != 0)
+        {
+            PoolObject<Timer<void> >::Instance().Clear(m_AsyncConnectTimerId);
+            m_AsyncConnectTimerId = 0;
+        }
+        m_bConnecting = false;
+        m_bConnected = true;
+
+        this->OnConnected(m_ServerInterface.m_Channel);
+
+        // OnConnected may close the connection.
+        if(m_ServerInterface.m_Channel.Socket != fd)
+            return -1;
+
+        if(!Pool::Instance().IsStartup())
+            return 0;
+
+        EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
+        if(bConnecting)
+            return scheduler.Update(this, EventScheduler::PollType::IN | m_dwEventFlags);
+        return scheduler.Register(this, EventScheduler::PollType::IN | m_dwEventFlags);
+    }
+
+    int GetConnectError()
+    {
+        int errinfo = 0;
+        socklen_t errlen = sizeof(int);
+        if(-1 == getsockopt(m_ServerInterface.m_Channel.Socket, SOL_SOCKET, SO_ERROR, &errinfo, &errlen))
+            return errno;
+        return errinfo;
+    }
+
     ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >  m_ServerInterface;
     typename Timer<void>::TimerID                               m_AsyncConnectTimerId;
+    bool                                                        m_bConnecting;
+    bool                                                        m_bConnected;
+    uint32_t                                                    m_dwConnectTimeout;
+    uint32_t                                                    m_dwEventFlags;
+    uint32_t                                                    m_dwWakeupBudget;
 };
 
 
@@ -8,167 +8,1444 @@
 #ifndef __TCPSERVER_HPP__
 #define __TCPSERVER_HPP__
 
+#include <poll.h>
+#include <netinet/tcp.h>
+#include <linux/filter.h>
+#include <linux/errqueue.h>
 #include <boost/function.hpp>
 #include <boost/bind.hpp>
+#include <boost/mpl/bool.hpp>
 #include "IOBuffer.hpp"
+#include "BufferPool.hpp"
+#include "ObjectPool.hpp"
 #include "Server.hpp"
 #include "EventScheduler.hpp"
+#include "Pool.hpp"
 #include "Clock.hpp"
 
 #define DEFAULT_SOCK_BACKLOG    100
 
+#ifndef SERVER_SEND_HIGH_WATERMARK
+    // pending send bytes that pause reading from a client
+    #define SERVER_SEND_HIGH_WATERMARK  4194304
+#endif
+
+#ifndef SERVER_SEND_LOW_WATERMARK
+    // pending send bytes that resume reading from a paused client
+    #define SERVER_SEND_LOW_WATERMARK   1048576
+#endif
+
+#ifndef SERVER_SEND_IOV_MAX
+    #define SERVER_SEND_IOV_MAX         64
+#endif
+
+#ifndef SERVER_MAX_BUFFER_SIZE
+    // limit of a pooled receive buffer, CacheSize = 0
+    #define SERVER_MAX_BUFFER_SIZE      16777216
+#endif
+
+#ifndef SERVER_RECV_OVERFLOW_SIZE
+    // stack buffer of a read that takes more than the free space of the cache
+    #define SERVER_RECV_OVERFLOW_SIZE   16384
+#endif
+
+#ifndef SERVER_SEND_CHUNK_SIZE
+    // queued replies are appended to the last chunk up to this size
+    #define SERVER_SEND_CHUNK_SIZE      65536
+#endif
+
+#ifndef SERVER_SPLICE_SIZE
+    // bytes moved through the worker pipe per splice, the default pipe size
+    #define SERVER_SPLICE_SIZE          65536
+#endif
+
+#ifndef SERVER_ZEROCOPY_MIN_SIZE
+    // smaller SendZeroCopy buffers are copied, pinning and completing the
+    // pages costs more than the copy
+    #define SERVER_ZEROCOPY_MIN_SIZE    16384
+#endif
+
+#ifndef SO_ZEROCOPY
+    #define SO_ZEROCOPY                 60
+#endif
+
+#ifndef MSG_ZEROCOPY
+    #define MSG_ZEROCOPY                0x4000000
+#endif
+
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+    #define SO_EE_ORIGIN_ZEROCOPY       5
+#endif
+
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+    #define SO_EE_CODE_ZEROCOPY_COPIED  1
+#endif
+
+struct TcpSendStats
+{
+    uint64_t Writes;
+    uint64_t Bytes;
+    uint64_t ZeroCopyWrites;    // MSG_ZEROCOPY sends
+    uint64_t ZeroCopyCopied;    // of them completed by a copy, e.g. on loopback
+};
+
+// a piece of queued output, bytes owned by the queue, a file region for
+// sendfile or a user buffer for MSG_ZEROCOPY.
+struct TcpSendChunk
+{
+    enum ChunkType
+    {
+        SEND_DATA,
+        SEND_FILE,
+        SEND_ZEROCOPY
+    };
+
+    ChunkType                   Type;
+    std::string                 Data;
+    int                         Fd;                 // SEND_FILE, a dup of the caller fd
+    off_t                       Offset;             // SEND_FILE, file offset of the next byte
+    const char*                 pBuffer;            // SEND_ZEROCOPY
+    size_t                      dwSize;
+    bool                        bZeroCopySent;      // a part went out with MSG_ZEROCOPY
+    uint32_t                    dwZeroCopySeq;      // sequence of the last such part
+    boost::function<void(void)> Release;
+
+    explicit TcpSendChunk(ChunkType type) :
+        Type(type),
+        Fd(-1),
+        Offset(0),
+        pBuffer(NULL),
+        dwSize(0),
+        bZeroCopySent(false),
+        dwZeroCopySeq(0)
+    {
+    }
+
+    inline size_t GetSize() const
+    {
+        return (Type == SEND_DATA) ? Data.size() : dwSize;
+    }
+};
+
+// bytes the socket did not take yet, flushed on EPOLLOUT or, with deferred
+// flush, at the end of the loop iteration. a connection that used
+// MSG_ZEROCOPY keeps its queue for the completion sequence of the socket,
+// and past its disconnect while the kernel still reads user buffers.
+struct TcpSendQueue
+{
+    std::list<TcpSendChunk> Chunks;
+    size_t                  dwOffset;
+    size_t                  dwPendingSize;
+    bool                    bPaused;
+    bool                    bWriteArmed;
+
+    // sent MSG_ZEROCOPY buffers by sequence, released on their completion.
+    std::list<std::pair<uint32_t, boost::function<void(void)> > > ZeroCopyList;
+    uint32_t                dwZeroCopySeq;
+    uint32_t                dwZeroCopyDone;     // sequences below are completed
+    bool                    bZeroCopy;
+    bool                    bClosing;           // disconnected, waiting for completions
+
+    TcpSendQueue() :
+        dwOffset(0),
+        dwPendingSize(0),
+        bPaused(false),
+        bWriteArmed(false),
+        dwZeroCopySeq(0),
+        dwZeroCopyDone(0),
+        bZeroCopy(false),
+        bClosing(false)
+    {
+    }
+
+    // files are closed and user buffers handed back, the completions of a
+    // disconnected client are waited for by Drop and the server.
+    ~TcpSendQueue()
+    {
+        for(std::list<TcpSendChunk>::iterator iter = Chunks.begin();
+            iter != Chunks.end();
+            ++iter)
+        {
+            if(iter->Type == TcpSendChunk::SEND_FILE)
+                close(iter->Fd);
+            else if(iter->Type == TcpSendChunk::SEND_ZEROCOPY && iter->Release)
+                iter->Release();
+        }
+
+        for(std::list<std::pair<uint32_t, boost::function<void(void)> > >::iterator iter = ZeroCopyList.begin();
+            iter != ZeroCopyList.end();
+            ++iter)
+        {
+            if(iter->second)
+                iter->second();
+        }
+    }
+
+    inline bool IsIdle()
+    {
+        return dwPendingSize == 0 && !bZeroCopy;
+    }
+
+    // a MSG_ZEROCOPY send is not completed yet, only the front chunk can be
+    // partly sent.
+    inline bool HasZeroCopyInFlight()
+    {
+        if(!ZeroCopyList.empty())
+            return true;
+        return (!Chunks.empty() && Chunks.front().bZeroCopySent &&
+                (int32_t)(Chunks.front().dwZeroCopySeq - dwZeroCopyDone) >= 0);
+    }
+
+    // the client is gone, the unsent output is dropped. a user buffer the
+    // kernel may still read is released on its completion.
+    void Drop()
+    {
+        for(std::list<TcpSendChunk>::iterator iter = Chunks.begin();
+            iter != Chunks.end();
+            ++iter)
+        {
+            if(iter->Type == TcpSendChunk::SEND_FILE)
+                close(iter->Fd);
+            else if(iter->Type == TcpSendChunk::SEND_ZEROCOPY)
+            {
+                if(iter->bZeroCopySent && (int32_t)(iter->dwZeroCopySeq - dwZeroCopyDone) >= 0)
+                    ZeroCopyList.push_back(std::make_pair(iter->dwZeroCopySeq, iter->Release));
+                else if(iter->Release)
+                    iter->Release();
+            }
+        }
+
+        Chunks.clear();
+        dwOffset = 0;
+        dwPendingSize = 0;
+        bClosing = true;
+    }
+
+    // pop the chunks a write of size bytes completed.
+    void Consume(size_t size)
+    {
+        dwPendingSize -= size;
+        size += dwOffset;
+        while(!Chunks.empty() && size >= Chunks.front().GetSize())
+        {
+            TcpSendChunk& chunk = Chunks.front();
+            size -= chunk.GetSize();
+
+            boost::function<void(void)> release;
+            if(chunk.Type == TcpSendChunk::SEND_FILE)
+                close(chunk.Fd);
+            else if(chunk.Type == TcpSendChunk::SEND_ZEROCOPY)
+            {
+                // the kernel may still read the buffer until the completion,
+                // unless the last zero-copy part completed before a copied one.
+                if(chunk.bZeroCopySent && (int32_t)(chunk.dwZeroCopySeq - dwZeroCopyDone) >= 0)
+                    ZeroCopyList.push_back(std::make_pair(chunk.dwZeroCopySeq, chunk.Release));
+                else
+                    release = chunk.Release;
+            }
+            Chunks.pop_front();
+
+            if(release)
+                release();
+        }
+        dwOffset = size;
+    }
+
+    // tcp completes in send order, a range ends at sequence last.
+    void Complete(uint32_t last)
+    {
+        if((int32_t)(last + 1 - dwZeroCopyDone) > 0)
+            dwZeroCopyDone = last + 1;
+        while(!ZeroCopyList.empty() && (int32_t)(ZeroCopyList.front().first - last) <= 0)
+        {
+            boost::function<void(void)> release = ZeroCopyList.front().second;
+            ZeroCopyList.pop_front();
+            if(release)
+                release();
+        }
+    }
+};
+
+// pipe of the worker for Splice, empty between calls.
+struct TcpSplicePipe
+{
+    int Fds[2];
+
+    TcpSplicePipe()
+    {
+        Fds[0] = Fds[1] = -1;
+    }
+
+    ~TcpSplicePipe()
+    {
+        if(Fds[0] != -1)
+        {
+            close(Fds[0]);
+            close(Fds[1]);
+        }
+    }
+
+    int Open()
+    {
+        if(Fds[0] != -1)
+            return 0;
+        return pipe2(Fds, O_NONBLOCK | O_CLOEXEC);
+    }
+
+    // drop what a failed splice left in the pipe.
+    void Drain()
+    {
+        char buffer[4096];
+        while(read(Fds[0], buffer, sizeof(buffer)) > 0)
+            ;
+    }
+};
+
+// sendfile and splice have no MSG_DONTWAIT. a blocking client socket is
+// non-blocking only while the scope lives, the plain sends of the user keep
+// blocking. Flags is -1 if the socket could not be switched.
+struct TcpNonblockScope
+{
+    int Fd;
+    int Flags;
+
+    TcpNonblockScope(int fd, bool enable) :
+        Fd(-1),
+        Flags(0)
+    {
+        if(!enable)
+            return;
+
+        Flags = fcntl(fd, F_GETFL, 0);
+        if(Flags == -1 || (Flags & O_NONBLOCK))
+            return;
+
+        if(-1 == fcntl(fd, F_SETFL, Flags | O_NONBLOCK))
+            Flags = -1;
+        else
+            Fd = fd;
+    }
+
+    ~TcpNonblockScope()
+    {
+        if(Fd != -1)
+            fcntl(Fd, F_SETFL, Flags);
+    }
+};
+
+// receive cache of a connection, the unread bytes are kept at the front.
+// what OnMessage left is moved back to the front after it, a partial
+// message only. that keeps the reads in the warm front of the cache, a
+// ring that never moves the bytes was slower in ringbench.
+struct TcpRecvCache
+{
+    // the free space of the cache, then overflow if given. returns the
+    // count of iov.
+    static inline int GetFreeSegments(iovec* iov, char* cache, uint32_t size, uint32_t availSize,
+                                      char* overflow = NULL, uint32_t overflowSize = 0)
+    {
+        int count = 0;
+        if(availSize < size)
+        {
+            iov[count].iov_base = &cache[availSize];
+            iov[count++].iov_len = size - availSize;
+        }
+
+        if(overflow && overflowSize > 0)
+        {
+            iov[count].iov_base = overflow;
+            iov[count++].iov_len = overflowSize;
+        }
+        return count;
+    }
+
+    // recv into the free space. a stream socket needs no peer address, a
+    // single segment is a plain recv and a scatter read is recvmsg without
+    // msg_name, readv that takes MSG_DONTWAIT. returns the size or a
+    // ChannelStatus.
+    static inline ssize_t Recv(int fd, char* cache, uint32_t size, uint32_t availSize,
+                               char* overflow = NULL, uint32_t overflowSize = 0)
+    {
+        iovec iov[2];
+        int count = GetFreeSegments(iov, cache, size, availSize, overflow, overflowSize);
+        if(count == 1)
+            return ChannelRecv(fd, (char*)iov[0].iov_base, iov[0].iov_len);
+
+        msghdr msg;
+        bzero(&msg, sizeof(msghdr));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        return ChannelRecvMsg(fd, &msg, MSG_DONTWAIT, true);
+    }
+
+    // copy up to dataSize bytes into the free space, returns the copied size.
+    static inline uint32_t Append(char* cache, uint32_t size, uint32_t& availSize,
+                                  const char* data, uint32_t dataSize)
+    {
+        uint32_t copySize = size - availSize;
+        if(copySize > dataSize)
+            copySize = dataSize;
+
+        memcpy(&cache[availSize], data, copySize);
+        availSize += copySize;
+        return copySize;
+    }
+
+    // release the bytes consumed by OnMessage.
+    static inline void Consume(char* cache, uint32_t& availSize, uint32_t consumeSize)
+    {
+        if(consumeSize >= availSize)
+        {
+            availSize = 0;
+            return;
+        }
+
+        availSize -= consumeSize;
+        if(consumeSize > 0)
+            memmove(cache, &cache[consumeSize], availSize);
+    }
+};
+
+// the server of a client, the stream operators of the channel write
+// through its send queue.
+template<typename ChannelT>
+class TcpChannelSender
+{
+public:
+    virtual ~TcpChannelSender()
+    {
+    }
+
+    virtual ssize_t SendChannel(ChannelT& channel, const char* buffer, size_t size) = 0;
+};
+
 template<typename ChannelDataT, uint32_t CacheSize>
 struct TcpChannelCache :
     public ChannelDataT
 {
-    uint32_t dwCacheAvailableSize;
-    char     cPackageCache[CacheSize];
+    uint32_t        dwCacheAvailableSize;
+    TcpSendQueue*   pSendQueue;
+    TcpChannelSender<Channel<TcpChannelCache> >* pSender;
+    char            cPackageCache[CacheSize];
+
+    // the data is value-initialized, a recycled ObjectPool slot must not
+    // keep the data of the last connection.
+    TcpChannelCache() :
+        ChannelDataT(),
+        dwCacheAvailableSize(0),
+        pSendQueue(NULL),
+        pSender(NULL)
+    {
+    }
 };
 template<uint32_t CacheSize>
 struct TcpChannelCache<void, CacheSize>
 {
-    uint32_t dwCacheAvailableSize;
-    char     cPackageCache[CacheSize];
+    uint32_t        dwCacheAvailableSize;
+    TcpSendQueue*   pSendQueue;
+    TcpChannelSender<Channel<TcpChannelCache> >* pSender;
+    char            cPackageCache[CacheSize];
+
+    TcpChannelCache() :
+        dwCacheAvailableSize(0),
+        pSendQueue(NULL),
+        pSender(NULL)
+    {
+    }
+};
+
+//
+// CacheSize = 0, no inline cache. an idle connection holds no buffer, reads
+// go through the worker scratch buffer and a BufferPool buffer is attached
+// only while a partial message is kept.
+//
+template<typename ChannelDataT>
+struct TcpChannelCache<ChannelDataT, 0> :
+    public ChannelDataT
+{
+    uint32_t        dwCacheAvailableSize;
+    TcpSendQueue*   pSendQueue;
+    TcpChannelSender<Channel<TcpChannelCache> >* pSender;
+    char*           pPackageCache;
+    uint32_t        dwCacheSize;
+
+    TcpChannelCache() :
+        ChannelDataT(),
+        dwCacheAvailableSize(0),
+        pSendQueue(NULL),
+        pSender(NULL),
+        pPackageCache(NULL),
+        dwCacheSize(0)
+    {
+    }
+};
+template<>
+struct TcpChannelCache<void, 0>
+{
+    uint32_t        dwCacheAvailableSize;
+    TcpSendQueue*   pSendQueue;
+    TcpChannelSender<Channel<TcpChannelCache> >* pSender;
+    char*           pPackageCache;
+    uint32_t        dwCacheSize;
+
+    TcpChannelCache() :
+        dwCacheAvailableSize(0),
+        pSendQueue(NULL),
+        pSender(NULL),
+        pPackageCache(NULL),
+        dwCacheSize(0)
+    {
+    }
+};
+
+// tcp channels are streams, the stream operators use plain recv and send
+// without the peer address. a client received by the poller is read from
+// it, flags apply to the other sockets.
+template<typename ChannelDataT, uint32_t CacheSize>
+ssize_t ReadChannel(Channel<TcpChannelCache<ChannelDataT, CacheSize> >& channel, IOBuffer& io, int flags = 0)
+{
+    iovec iov;
+    iov.iov_base = io.m_Buffer;
+    iov.iov_len = io.m_BufferSize;
+    ssize_t recvSize = PoolObject<EventScheduler>::Instance().GetPoll().Recv(channel.Socket, &iov, 1, flags);
+
+    io.m_AvailableReadSize = (recvSize > 0) ? recvSize : 0;
+    io.m_ReadPosition = 0;
+    return recvSize;
+}
+
+// what the socket did not take is kept at the front of io.
+template<typename ChannelDataT, uint32_t CacheSize>
+ssize_t WriteChannel(Channel<TcpChannelCache<ChannelDataT, CacheSize> >& channel, IOBuffer& io, int flags = MSG_NOSIGNAL)
+{
+    if(io.m_WritePosition == 0)
+        return 0;
+
+    ssize_t sendSize = ChannelSend(channel.Socket, io.m_Buffer, io.m_WritePosition, flags);
+    if(sendSize > 0)
+    {
+        memmove(io.m_Buffer, &io.m_Buffer[sendSize], io.m_WritePosition - sendSize);
+        io.m_WritePosition -= sendSize;
+    }
+    return sendSize;
+}
+
+// a client of a TcpServer writes through the send queue of the server, see
+// TcpServer::Send. other tcp channels use WriteChannel, the unsent bytes
+// stay in io. only a send error throws.
+template<typename ChannelDataT, uint32_t CacheSize>
+Channel<TcpChannelCache<ChannelDataT, CacheSize> >& operator << (Channel<TcpChannelCache<ChannelDataT, CacheSize> >& channel, IOBuffer& io)
+{
+    ssize_t sendSize = 0;
+    if(channel.Data.pSender)
+    {
+        sendSize = channel.Data.pSender->SendChannel(channel, io.m_Buffer, io.m_WritePosition);
+        if(sendSize >= 0)
+            io.m_WritePosition = 0;
+    }
+    else
+        sendSize = WriteChannel(channel, io, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+    if(sendSize < 0 && sendSize != CHANNEL_AGAIN)
+        throw InternalException((boost::format("[%s:%d][error] send fail, %s.") % __FILE__ % __LINE__ % safe_strerror(errno)).str().c_str());
+    return channel;
+}
+
+template<typename ChannelDataT, uint32_t CacheSize>
+inline Channel<TcpChannelCache<ChannelDataT, CacheSize> >& operator << (Channel<TcpChannelCache<ChannelDataT, CacheSize> >& channel, IOBuffer* pIOBuffer)
+{
+    return channel << *pIOBuffer;
+}
+
+// accept counters, wakeups of the listener, accepted connections and
+// wakeups that found nothing to accept (lost the race to another worker).
+struct TcpAcceptStats
+{
+    uint64_t Wakeups;
+    uint64_t Accepts;
+    uint64_t Misses;
 };
 
-template<typename ServerImplT, typename ChannelDataT = void, uint32_t CacheSize = 65535>
-class TcpServer
-{
-public:
-    typedef Channel<TcpChannelCache<ChannelDataT, CacheSize> > ChannelType;
+template<typename ServerImplT, typename ChannelDataT = void, uint32_t CacheSize = 65535>
+class TcpServer :
+    public TcpChannelSender<Channel<TcpChannelCache<ChannelDataT, CacheSize> > >
+{
+public:
+    typedef Channel<TcpChannelCache<ChannelDataT, CacheSize> > ChannelType;
+
+    int Listen(sockaddr_in& addr)
+    {
+        if(m_ServerInterface.m_Channel.Socket == -1)
+            return -1;
+
+        if(-1 == bind(m_ServerInterface.m_Channel.Socket, (sockaddr*)&addr, sizeof(sockaddr_in)))
+        {
+            close(m_ServerInterface.m_Channel.Socket);
+            m_ServerInterface.m_Channel.Socket = -1;
+            return -1;
+        }
+
+        if(-1 == listen(m_ServerInterface.m_Channel.Socket, DEFAULT_SOCK_BACKLOG))
+        {
+            close(m_ServerInterface.m_Channel.Socket);
+            m_ServerInterface.m_Channel.Socket = -1;
+            return -1;
+        }
+
+        return 0;
+    }
+
+    // a listener of its own for the calling worker, bound with SO_REUSEPORT
+    // next to the listeners of the other workers so the kernel hands each
+    // connection to one of them. with cpu steering the connection goes to the
+    // listener whose index in the group is the cpu that received it, which
+    // assumes worker N runs on cpu N.
+    ServerInterface<void>* CreateListener(sockaddr_in& addr)
+    {
+#ifdef __USE_GNU
+        int fd = socket(PF_INET, SOCK_STREAM|SOCK_CLOEXEC, 0);
+        if(fd == -1)
+            return NULL;
+#else
+        int fd = socket(PF_INET, SOCK_STREAM, 0);
+        if(fd == -1)
+            return NULL;
+
+        if(SetCloexecFd(fd) < 0)
+        {
+            close(fd);
+            return NULL;
+        }
+#endif
+        int reuse = 1;
+        if(-1 == setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(int)) ||
+           -1 == setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(int)))
+        {
+            close(fd);
+            return NULL;
+        }
+
+        if(-1 == bind(fd, (sockaddr*)&addr, sizeof(sockaddr_in)) ||
+           -1 == listen(fd, DEFAULT_SOCK_BACKLOG) ||
+           ((m_dwEventFlags & EventScheduler::PollType::ET) && SetNonblockFd(fd) < 0))
+        {
+            close(fd);
+            return NULL;
+        }
+
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+        // after bind, a socket with a program of its own cannot join the group,
+        // the program attached here replaces the one of the whole group.
+        if(m_bCpuSteering)
+        {
+            sock_filter code[] = {
+                { BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU) },
+                { BPF_RET | BPF_A, 0, 0, 0 }
+            };
+            sock_fprog prog;
+            prog.len = sizeof(code) / sizeof(sock_filter);
+            prog.filter = code;
+            if(-1 == setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(sock_fprog)))
+                LOG("attach reuseport cpu steering fail, %s.", safe_strerror(errno));
+        }
+#endif
+
+        ServerInterface<void>* pListener = new ServerInterface<void>();
+        pListener->m_Channel.Socket = fd;
+        memcpy(&pListener->m_Channel.Address, &addr, sizeof(sockaddr_in));
+        pListener->m_ReadableCallback = boost::bind(&ServerImplT::OnAcceptable, this, _1);
+        return pListener;
+    }
+
+    void OnAcceptable(ServerInterface<void>* pInterface)
+    {
+        __sync_fetch_and_add(&m_AcceptStats.Wakeups, 1);
+
+        if(!(m_dwEventFlags & EventScheduler::PollType::ET))
+        {
+            AcceptClient(pInterface);
+            return;
+        }
+
+        // edge-triggered, accept until EAGAIN or the accept budget is used up.
+        for(uint32_t i = 0; i < m_dwAcceptBudget; ++i)
+        {
+            if(!AcceptClient(pInterface))
+                return;
+        }
+
+        // the pending connections wait on the ready list behind the clients.
+        PoolObject<EventScheduler>::Instance().SetReady(pInterface);
+    }
+
+    bool AcceptClient(ServerInterface<void>* pInterface)
+    {
+        sockaddr_in cliAddr;
+        bzero(&cliAddr, sizeof(sockaddr_in));
+
+#ifdef __USE_GNU
+        int flags = SOCK_CLOEXEC;
+        if(m_dwEventFlags & EventScheduler::PollType::ET)
+            flags |= SOCK_NONBLOCK;
+
+        int clifd = PoolObject<EventScheduler>::Instance().GetPoll().Accept(pInterface->m_Channel.Socket, &cliAddr, flags);
+        if(clifd == -1)
+        {
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                __sync_fetch_and_add(&m_AcceptStats.Misses, 1);
+                return false;
+            }
+
+            // the client went away before accept, keep draining the queue.
+            if(errno == EINTR || errno == ECONNABORTED || errno == EPROTO)
+                return true;
+            throw InternalException((boost::format("[%s:%d][error] accept fail, %s.") 
+                                        % __FILE__ % __LINE__ % safe_strerror(errno)).str().c_str());
+        }
+#else
+        socklen_t len = sizeof(sockaddr_in);
+        int clifd = accept(pInterface->m_Channel.Socket, (sockaddr*)&cliAddr, &len);
+        if(clifd == -1)
+        {
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                __sync_fetch_and_add(&m_AcceptStats.Misses, 1);
+                return false;
+            }
+
+            // the client went away before accept, keep draining the queue.
+            if(errno == EINTR || errno == ECONNABORTED || errno == EPROTO)
+                return true;
+            throw InternalException((boost::format("[%s:%d][error] accept fail, %s.") 
+                                        % __FILE__ % __LINE__ % safe_strerror(errno)).str().c_str());
+        }
+
+        if(SetCloexecFd(clifd) < 0 || 
+           ((m_dwEventFlags & EventScheduler::PollType::ET) && SetNonblockFd(clifd) < 0))
+        {
+            close(clifd);
+            throw InternalException((boost::format("[%s:%d][error] SetNonblockAndCloexecFd fail, %s.") 
+                                        % __FILE__ % __LINE__ % safe_strerror(errno)).str().c_str());
+        }
+#endif
+        __sync_fetch_and_add(&m_AcceptStats.Accepts, 1);
+
+        AddClient(clifd, cliAddr);
+        return true;
+    }
+
+    // register an accepted client with the scheduler of the calling worker.
+    void AddClient(int clifd, sockaddr_in& cliAddr)
+    {
+        ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pChannelInterface = 
+            PoolObject<ObjectPool<ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> > > >::Instance().Alloc();
+        if(!pChannelInterface)
+        {
+            close(clifd);
+            RemoveClient();
+            throw InternalException((boost::format("[%s:%d][error] alloc client interface fail.") % __FILE__ % __LINE__).str().c_str());
+        }
+
+        pChannelInterface->m_Channel.Socket = clifd;
+        memcpy(&pChannelInterface->m_Channel.Address, &cliAddr, sizeof(sockaddr_in));
+        pChannelInterface->m_Channel.Data.pSender = this;
+
+        pChannelInterface->SetHandler(reinterpret_cast<ServerImplT*>(this));
+
+        EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
+        if(scheduler.Register(pChannelInterface, EventScheduler::PollType::IN | EventScheduler::PollType::RECV | m_dwEventFlags) == -1)
+        {
+            shutdown(pChannelInterface->m_Channel.Socket, SHUT_RDWR);
+            close(pChannelInterface->m_Channel.Socket);
+            FreeClient(pChannelInterface);
+            RemoveClient();
+            throw InternalException((boost::format("[%s:%d][error] epoll_ctl add new sockfd fail, %s.") 
+                                        % __FILE__ % __LINE__ % safe_strerror(errno)).str().c_str());
+        }
+
+        this->OnConnected(pChannelInterface->m_Channel);
+    }
+
+    //
+    // acceptor mode, ThreadPool only. one thread owns the listener, accepts
+    // and hands every client to the worker with the fewest live connections
+    // through EventScheduler::Post. the listener is not registered with the
+    // workers, see TcpServerStartup.
+    //
+    inline void SetAcceptor(bool enable)
+    {
+        m_bAcceptor = enable;
+    }
+
+    inline bool IsAcceptor()
+    {
+        return m_bAcceptor;
+    }
+
+    int StartAcceptor()
+    {
+        uint32_t concurrency = ThreadPool::Instance().GetConcurrency();
+        if(concurrency == 0 || m_ServerInterface.m_Channel.Socket == -1)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+
+        m_WorkerConnections.assign(concurrency, 0);
+
+        pthread_t tid;
+        if(0 != pthread_create(&tid, NULL, TcpServer<ServerImplT, ChannelDataT, CacheSize>::AcceptorProc, this))
+            return -1;
+
+        pthread_detach(tid);
+        return 0;
+    }
+
+    // live connections of worker id in acceptor mode.
+    inline uint32_t GetWorkerConnections(uint32_t id)
+    {
+        if(id >= m_WorkerConnections.size())
+            return 0;
+        return __sync_fetch_and_add(&m_WorkerConnections[id], 0);
+    }
+
+    static void* AcceptorProc(void* paramenter)
+    {
+        reinterpret_cast<TcpServer<ServerImplT, ChannelDataT, CacheSize>*>(paramenter)->RunAcceptor();
+        return NULL;
+    }
+
+    void RunAcceptor()
+    {
+        int listenfd = m_ServerInterface.m_Channel.Socket;
+        int flags = SOCK_CLOEXEC;
+        if(m_dwEventFlags & EventScheduler::PollType::ET)
+            flags |= SOCK_NONBLOCK;
+
+        while(true)
+        {
+            sockaddr_in cliAddr;
+            bzero(&cliAddr, sizeof(sockaddr_in));
+            socklen_t len = sizeof(sockaddr_in);
+
+            int clifd = accept4(listenfd, (sockaddr*)&cliAddr, &len, flags);
+            if(clifd == -1)
+            {
+                if(errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    // non-blocking listener from edge-triggered mode.
+                    pollfd stPollInfo;
+                    stPollInfo.fd = listenfd;
+                    stPollInfo.events = POLLIN;
+                    stPollInfo.revents = 0;
+                    poll(&stPollInfo, 1, -1);
+                    continue;
+                }
+                if(errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                if(errno == EBADF || errno == EINVAL)
+                    return;
+
+                LOG("acceptor accept fail, %s.", safe_strerror(errno));
+                usleep(10000);
+                continue;
+            }
+            __sync_fetch_and_add(&m_AcceptStats.Accepts, 1);
+
+            uint32_t id = 0;
+            EventScheduler* pScheduler = GetLeastLoadedScheduler(&id);
+            if(!pScheduler)
+            {
+                close(clifd);
+                continue;
+            }
+
+            __sync_fetch_and_add(&m_WorkerConnections[id], 1);
+            pScheduler->Post(boost::bind(&TcpServer<ServerImplT, ChannelDataT, CacheSize>::OnHandoff, this, clifd, cliAddr));
+        }
+    }
+
+    EventScheduler* GetLeastLoadedScheduler(uint32_t* pID)
+    {
+        // workers still starting up have no scheduler yet, wait for the first.
+        ThreadPool& pool = ThreadPool::Instance();
+        while(true)
+        {
+            EventScheduler* pScheduler = NULL;
+            uint32_t dwMinConnections = 0;
+            for(uint32_t id = 0; id < m_WorkerConnections.size(); ++id)
+            {
+                EventScheduler* pWorkerScheduler = pool.GetScheduler(id);
+                if(!pWorkerScheduler)
+                    continue;
+
+                uint32_t dwConnections = GetWorkerConnections(id);
+                if(!pScheduler || dwConnections < dwMinConnections)
+                {
+                    pScheduler = pWorkerScheduler;
+                    dwMinConnections = dwConnections;
+                    *pID = id;
+                }
+            }
+
+            if(pScheduler || m_WorkerConnections.empty())
+                return pScheduler;
+            usleep(1000);
+        }
+    }
+
+    void OnHandoff(int clifd, sockaddr_in cliAddr)
+    {
+        AddClient(clifd, cliAddr);
+    }
+
+    // client interfaces come from the slab pool of the worker.
+    inline void FreeClient(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
+    {
+        delete pInterface->m_Channel.Data.pSendQueue;
+        PoolObject<ObjectPool<ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> > > >::Instance().Free(pInterface);
+    }
+
+    // occupancy of the client interface pool of the calling worker.
+    inline void DumpClientPool(std::string& strDump)
+    {
+        PoolObject<ObjectPool<ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> > > >::Instance().Dump(strDump);
+    }
+
+    inline void RemoveClient()
+    {
+        if(m_bAcceptor && !m_WorkerConnections.empty())
+            __sync_fetch_and_sub(&m_WorkerConnections[Pool::Instance().GetID()], 1);
+    }
+
+    void OnReadable(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
+    {
+        // paused on the send high watermark, possibly left on the ready list.
+        if(pInterface->m_Channel.Data.pSendQueue && pInterface->m_Channel.Data.pSendQueue->bPaused)
+            return;
+
+        if(!(m_dwEventFlags & EventScheduler::PollType::ET))
+        {
+            ReadClient(pInterface);
+            return;
+        }
+
+        // edge-triggered, read until EAGAIN or the read or byte budget is used up.
+        uint32_t dwByteSize = 0;
+        for(uint32_t i = 0; i < m_dwWakeupBudget && dwByteSize < m_dwByteBudget; ++i)
+        {
+            int recvSize = ReadClient(pInterface);
+            if(recvSize <= 0)
+                return;
+            dwByteSize += recvSize;
+        }
+
+        PoolObject<EventScheduler>::Instance().SetReady(pInterface);
+    }
+
+    // return the read size, 0 on EAGAIN, -1 if the client is disconnected.
+    inline int ReadClient(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
+    {
+        return ReadClient(pInterface, boost::mpl::bool_<CacheSize == 0>());
+    }
+
+    int ReadClient(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface, boost::mpl::false_)
+    {
+        TcpChannelCache<ChannelDataT, CacheSize>& cache = pInterface->m_Channel.Data;
+        if(cache.dwCacheAvailableSize >= CacheSize)
+            return FailClient(pInterface, "package cache is full");
+
+        // bytes beyond the free space of the cache land in the stack buffer
+        // and are fed in as OnMessage releases space.
+        char cOverflow[SERVER_RECV_OVERFLOW_SIZE];
+        uint32_t dwFreeSize = CacheSize - cache.dwCacheAvailableSize;
+
+        iovec iov[2];
+        int count = TcpRecvCache::GetFreeSegments(iov, cache.cPackageCache, CacheSize, cache.dwCacheAvailableSize,
+                                                  cOverflow, SERVER_RECV_OVERFLOW_SIZE);
+        ssize_t recvSize = PoolObject<EventScheduler>::Instance().GetPoll().Recv(pInterface->m_Channel.Socket, iov, count);
+        if(recvSize < 0)
+            return OnReadStatus(pInterface, recvSize);
+
+        uint32_t dwOverflowSize = ((uint32_t)recvSize > dwFreeSize) ? recvSize - dwFreeSize : 0;
+        uint32_t dwOverflowPosition = 0;
+        cache.dwCacheAvailableSize += recvSize - dwOverflowSize;
+
+        while(true)
+        {
+            int consumeSize = DeliverClient(pInterface, cache.cPackageCache, cache.dwCacheAvailableSize);
+            if(consumeSize == -1)
+                return -1;
+
+            if(dwOverflowPosition == dwOverflowSize)
+                return recvSize;
+
+            if(consumeSize == 0)
+                return FailClient(pInterface, "package cache is full");
+
+            dwOverflowPosition += TcpRecvCache::Append(cache.cPackageCache, CacheSize, cache.dwCacheAvailableSize,
+                                                       &cOverflow[dwOverflowPosition], dwOverflowSize - dwOverflowPosition);
+        }
+    }
+
+    int ReadClient(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface, boost::mpl::true_)
+    {
+        TcpChannelCache<ChannelDataT, CacheSize>& cache = pInterface->m_Channel.Data;
+        BufferPool& pool = PoolObject<BufferPool>::Instance();
+
+        if(cache.pPackageCache && cache.dwCacheAvailableSize == cache.dwCacheSize &&
+           !GrowCache(pInterface, cache, cache.dwCacheSize + 1))
+            return FailClient(pInterface, "package cache is full");
+
+        // bytes beyond the free space of the buffer land in the scratch
+        // buffer, an idle connection reads into the scratch buffer only.
+        char* pScratch = pool.GetScratch();
+        uint32_t dwFreeSize = 0;
+
+        iovec iov[2];
+        int count = 1;
+        if(cache.pPackageCache)
+        {
+            dwFreeSize = cache.dwCacheSize - cache.dwCacheAvailableSize;
+            count = TcpRecvCache::GetFreeSegments(iov, cache.pPackageCache, cache.dwCacheSize, cache.dwCacheAvailableSize,
+                                                  pScratch, pool.GetScratchSize());
+        }
+        else
+        {
+            iov[0].iov_base = pScratch;
+            iov[0].iov_len = pool.GetScratchSize();
+        }
+        ssize_t recvSize = PoolObject<EventScheduler>::Instance().GetPoll().Recv(pInterface->m_Channel.Socket, iov, count);
+        if(recvSize < 0)
+            return OnReadStatus(pInterface, recvSize);
+
+        uint32_t dwOverflowSize = ((uint32_t)recvSize > dwFreeSize) ? recvSize - dwFreeSize : 0;
+        uint32_t dwOverflowPosition = 0;
+        cache.dwCacheAvailableSize += recvSize - dwOverflowSize;
+
+        if(!cache.pPackageCache)
+        {
+            // whole messages are framed straight from the scratch buffer.
+            IOBuffer in(pScratch, recvSize, recvSize);
+            this->OnMessage(pInterface->m_Channel, in);
+            if(PoolObject<EventScheduler>::Instance().IsDispatchReleased())
+                return -1;
+
+            dwOverflowPosition = in.GetReadPosition();
+        }
+        else if(DeliverClient(pInterface, cache.pPackageCache, cache.dwCacheAvailableSize) == -1)
+            return -1;
 
-    int Listen(sockaddr_in& addr)
+        while(dwOverflowPosition < dwOverflowSize)
+        {
+            // size the buffer from the pending bytes rather than doubling
+            // once per read.
+            uint32_t dwPendingSize = cache.dwCacheAvailableSize + dwOverflowSize - dwOverflowPosition;
+            if(dwPendingSize > cache.dwCacheSize && !GrowCache(pInterface, cache, dwPendingSize) &&
+               cache.dwCacheAvailableSize == cache.dwCacheSize)
+                return FailClient(pInterface, "package cache is full");
+
+            dwOverflowPosition += TcpRecvCache::Append(cache.pPackageCache, cache.dwCacheSize, cache.dwCacheAvailableSize,
+                                                       &pScratch[dwOverflowPosition], dwOverflowSize - dwOverflowPosition);
+            if(DeliverClient(pInterface, cache.pPackageCache, cache.dwCacheAvailableSize) == -1)
+                return -1;
+        }
+
+        if(cache.dwCacheAvailableSize == 0)
+        {
+            // the connection is idle again, give the buffer back.
+            FreeCache(cache, boost::mpl::true_());
+        }
+        return recvSize;
+    }
+
+    // grow the pooled buffer to needSize, at least doubling, up to the per
+    // connection limit. return false if it is at the limit.
+    bool GrowCache(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface,
+                   TcpChannelCache<ChannelDataT, CacheSize>& cache, uint32_t needSize)
     {
-        if(m_ServerInterface.m_Channel.Socket == -1)
-            return -1;
+        BufferPool& pool = PoolObject<BufferPool>::Instance();
 
-        if(-1 == bind(m_ServerInterface.m_Channel.Socket, (sockaddr*)&addr, sizeof(sockaddr_in)))
+        uint32_t dwNewSize = cache.dwCacheSize * 2;
+        if(dwNewSize < needSize)
+            dwNewSize = needSize;
+        if(dwNewSize > m_dwMaxBufferSize)
+            dwNewSize = m_dwMaxBufferSize;
+        if(dwNewSize <= cache.dwCacheSize)
+            return false;
+
+        char* pNewBuffer = pool.Alloc(dwNewSize, &dwNewSize);
+        if(!pNewBuffer)
         {
-            close(m_ServerInterface.m_Channel.Socket);
-            m_ServerInterface.m_Channel.Socket = -1;
-            return -1;
+            this->DisconnectClient(pInterface->m_Channel);
+
+            throw InternalException((boost::format("[%s:%d][error] alloc package cache fail.") % __FILE__ % __LINE__).str().c_str());
         }
 
-        if(-1 == listen(m_ServerInterface.m_Channel.Socket, DEFAULT_SOCK_BACKLOG))
+        if(cache.pPackageCache)
         {
-            close(m_ServerInterface.m_Channel.Socket);
-            m_ServerInterface.m_Channel.Socket = -1;
-            return -1;
+            memcpy(pNewBuffer, cache.pPackageCache, cache.dwCacheAvailableSize);
+            pool.Free(cache.pPackageCache, cache.dwCacheSize);
         }
+        cache.pPackageCache = pNewBuffer;
+        cache.dwCacheSize = dwNewSize;
+        return true;
+    }
 
-        return 0;
+    // hand the unread bytes to OnMessage and move what it left to the front.
+    // return the consumed size, -1 if the client is released.
+    int DeliverClient(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface,
+                      char* cache, uint32_t& availSize)
+    {
+        IOBuffer in(cache, availSize, availSize);
+        this->OnMessage(pInterface->m_Channel, in);
+
+        // OnMessage may disconnect the client.
+        if(PoolObject<EventScheduler>::Instance().IsDispatchReleased())
+            return -1;
+
+        TcpRecvCache::Consume(cache, availSize, in.GetReadPosition());
+        return in.GetReadPosition();
     }
 
-    void OnAcceptable(ServerInterface<void>* pInterface)
+    // map a failed read to the ReadClient result, the client is closed
+    // unless the socket is just drained.
+    int OnReadStatus(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface, ssize_t status)
     {
-        sockaddr_in cliAddr;
-        bzero(&cliAddr, sizeof(sockaddr_in));
-        socklen_t len = sizeof(sockaddr_in);
+        if(status == CHANNEL_AGAIN)
+            return 0;
 
-#ifdef __USE_GNU
-        int clifd = accept4(pInterface->m_Channel.Socket, (sockaddr*)&cliAddr, &len, SOCK_CLOEXEC);
-        if(clifd == -1)
+        if(status == CHANNEL_ERROR)
+            this->OnError(pInterface->m_Channel);
+        this->DisconnectClient(pInterface->m_Channel);
+        return -1;
+    }
+
+    // a client that broke the protocol, it is closed without an exception.
+    int FailClient(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface, const char* reason)
+    {
+        LOG("[%s:%d] %s, disconnect client.", inet_ntoa(pInterface->m_Channel.Address.sin_addr), 
+            ntohs(pInterface->m_Channel.Address.sin_port), reason);
+
+        this->OnError(pInterface->m_Channel);
+        this->DisconnectClient(pInterface->m_Channel);
+        return -1;
+    }
+
+    inline void FreeCache(TcpChannelCache<ChannelDataT, CacheSize>& cache, boost::mpl::false_)
+    {
+    }
+
+    void FreeCache(TcpChannelCache<ChannelDataT, CacheSize>& cache, boost::mpl::true_)
+    {
+        if(cache.pPackageCache)
         {
-            if(errno == EAGAIN || errno == EWOULDBLOCK)
-                return;
-            throw InternalException((boost::format("[%s:%d][error] accept fail, %s.") 
-                                        % __FILE__ % __LINE__ % safe_strerror(errno)).str().c_str());
+            PoolObject<BufferPool>::Instance().Free(cache.pPackageCache, cache.dwCacheSize);
+            cache.pPackageCache = NULL;
+            cache.dwCacheSize = 0;
         }
-#else
-        int clifd = accept(pInterface->m_Channel.Socket, (sockaddr*)&cliAddr, &len);
-        if(clifd == -1)
+        cache.dwCacheAvailableSize = 0;
+    }
+
+    // limit of the pooled receive buffer of a connection, CacheSize = 0 only.
+    inline void SetMaxBufferSize(uint32_t size)
+    {
+        m_dwMaxBufferSize = (size < BUFFERPOOL_CHUNK_SIZE) ? BUFFERPOOL_CHUNK_SIZE : size;
+    }
+
+    void OnWriteable(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
+    {
+        if(FlushClient(pInterface) == -1)
         {
-            if(errno == EAGAIN || errno == EWOULDBLOCK)
-                return;
-            throw InternalException((boost::format("[%s:%d][error] accept fail, %s.") 
-                                        % __FILE__ % __LINE__ % safe_strerror(errno)).str().c_str());
+            this->OnError(pInterface->m_Channel);
+            this->DisconnectClient(pInterface->m_Channel);
         }
+    }
+
+    // write the send queue until it is empty or the socket is full, EPOLLOUT
+    // is disarmed once the queue is empty and reading resumes on the low
+    // watermark. return -1 on a send error.
+    int FlushClient(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
+    {
+        TcpSendQueue* pQueue = pInterface->m_Channel.Data.pSendQueue;
+        if(!pQueue)
+            return 0;
+
+        // a single buffer goes out in one write, cork only to join several.
+        int cork = 1;
+        bool bCork = (m_bCork && !pQueue->Chunks.empty() && ++pQueue->Chunks.begin() != pQueue->Chunks.end());
+        if(bCork)
+            setsockopt(pInterface->m_Channel.Socket, IPPROTO_TCP, TCP_CORK, &cork, sizeof(int));
 
-        if(SetCloexecFd(clifd) < 0)
+        while(pQueue->dwPendingSize > 0)
         {
-            close(clifd);
-            throw InternalException((boost::format("[%s:%d][error] SetNonblockAndCloexecFd fail, %s.") 
-                                        % __FILE__ % __LINE__ % safe_strerror(errno)).str().c_str());
+            TcpSendChunk& chunk = pQueue->Chunks.front();
+
+            ssize_t sendSize = 0;
+            if(chunk.Type == TcpSendChunk::SEND_FILE)
+            {
+                TcpNonblockScope nonblock(pInterface->m_Channel.Socket, !(m_dwEventFlags & EventScheduler::PollType::ET));
+                if(nonblock.Flags == -1)
+                    sendSize = CHANNEL_ERROR;
+                else
+                    sendSize = ChannelSendFile(pInterface->m_Channel.Socket, chunk.Fd, &chunk.Offset, chunk.dwSize - pQueue->dwOffset);
+            }
+            else if(chunk.Type == TcpSendChunk::SEND_ZEROCOPY)
+                sendSize = SendZeroCopyChunk(pInterface->m_Channel.Socket, pQueue, chunk);
+            else
+            {
+                // the byte chunks up to the next file or user buffer.
+                iovec iov[SERVER_SEND_IOV_MAX];
+                size_t offset = pQueue->dwOffset;
+                int count = 0;
+                for(std::list<TcpSendChunk>::iterator iter = pQueue->Chunks.begin();
+                    iter != pQueue->Chunks.end() && iter->Type == TcpSendChunk::SEND_DATA && count < SERVER_SEND_IOV_MAX;
+                    ++iter)
+                {
+                    iov[count].iov_base = const_cast<char*>(iter->Data.data()) + offset;
+                    iov[count].iov_len = iter->Data.size() - offset;
+                    offset = 0;
+                    ++count;
+                }
+
+                // writev with MSG_NOSIGNAL.
+                msghdr msg;
+                bzero(&msg, sizeof(msghdr));
+                msg.msg_iov = iov;
+                msg.msg_iovlen = count;
+
+                sendSize = ChannelSendMsg(pInterface->m_Channel.Socket, &msg);
+            }
+
+            if(sendSize == CHANNEL_AGAIN)
+                break;
+            if(sendSize < 0)
+                return -1;
+            __sync_fetch_and_add(&m_SendStats.Writes, 1);
+            __sync_fetch_and_add(&m_SendStats.Bytes, sendSize);
+
+            pQueue->Consume(sendSize);
+        }
+
+        if(bCork)
+        {
+            // uncork pushes out the last partial segment.
+            cork = 0;
+            setsockopt(pInterface->m_Channel.Socket, IPPROTO_TCP, TCP_CORK, &cork, sizeof(int));
         }
-#endif
-        ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pChannelInterface = 
-            new ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >();
-        pChannelInterface->m_Channel.Socket = clifd;
-        memcpy(&pChannelInterface->m_Channel.Address, &cliAddr, sizeof(sockaddr_in));
 
-        pChannelInterface->m_ReadableCallback = boost::bind(&ServerImplT::OnReadable, reinterpret_cast<ServerImplT*>(this), _1);
-        pChannelInterface->m_WriteableCallback = boost::bind(&ServerImplT::OnWriteable, reinterpret_cast<ServerImplT*>(this), _1);
-        pChannelInterface->m_ErrorCallback = boost::bind(&ServerImplT::OnErrorable, reinterpret_cast<ServerImplT*>(this), _1);
+        bool bResume = (pQueue->bPaused && pQueue->dwPendingSize <= m_dwLowWatermark);
+        if(bResume)
+            pQueue->bPaused = false;
 
-        EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
-        if(scheduler.Register(pChannelInterface, EventScheduler::PollType::IN) == -1)
+        if(pQueue->IsIdle())
         {
-            shutdown(pChannelInterface->m_Channel.Socket, SHUT_RDWR);
-            close(pChannelInterface->m_Channel.Socket);
-            delete pChannelInterface;
-            throw InternalException((boost::format("[%s:%d][error] epoll_ctl add new sockfd fail, %s.") 
-                                        % __FILE__ % __LINE__ % safe_strerror(errno)).str().c_str());
+            bool bUpdate = (bResume || pQueue->bWriteArmed);
+            delete pQueue;
+            pInterface->m_Channel.Data.pSendQueue = NULL;
+            if(bUpdate)
+                UpdateClientEvents(pInterface);
+        }
+        else if(pQueue->dwPendingSize == 0)
+        {
+            if(bResume || pQueue->bWriteArmed)
+                UpdateClientEvents(pInterface);
         }
+        else if(bResume || !pQueue->bWriteArmed)
+            UpdateClientEvents(pInterface);
+        return 0;
+    }
 
-        this->OnConnected(pChannelInterface->m_Channel);
+    inline void UpdateClientEvents(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
+    {
+        TcpSendQueue* pQueue = pInterface->m_Channel.Data.pSendQueue;
+
+        uint32_t events = m_dwEventFlags;
+        if(!pQueue || !pQueue->bPaused)
+            events |= EventScheduler::PollType::IN;
+        if(pQueue && pQueue->dwPendingSize > 0)
+            events |= EventScheduler::PollType::OUT;
+        // io_uring reports the error queue of a RECV socket only when asked.
+        if(pQueue && pQueue->bZeroCopy)
+            events |= EventScheduler::PollType::ERR;
+        if(pQueue)
+            pQueue->bWriteArmed = (pQueue->dwPendingSize > 0);
+        PoolObject<EventScheduler>::Instance().Update(pInterface, events);
     }
 
-    void OnReadable(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
+    // account bytes appended to the send queue and get them written, now by
+    // FlushClient if flush is set and nothing was pending, on EPOLLOUT or at
+    // the end of the loop iteration otherwise.
+    int OnSendQueued(ChannelType& channel, TcpSendQueue* pQueue, size_t size, bool flush)
     {
-        int dwRemainSize = CacheSize - pInterface->m_Channel.Data.dwCacheAvailableSize;
-        if(dwRemainSize <= 0)
-        {
-            this->DisconnectClient(pInterface->m_Channel);
+        bool bArm = (pQueue->dwPendingSize == 0);
+        pQueue->dwPendingSize += size;
 
-            throw InternalException((boost::format("[%s:%d][error] package cache is full.") % __FILE__ % __LINE__).str().c_str());
+        // stop reading from a client that does not drain its replies.
+        bool bPause = (!pQueue->bPaused && pQueue->dwPendingSize >= m_dwHighWatermark);
+        if(bPause)
+            pQueue->bPaused = true;
+
+        if(m_bDeferredFlush)
+        {
+            // gathered until the end of the loop iteration, unless EPOLLOUT
+            // is armed already and flushes it.
+            if(!pQueue->bWriteArmed)
+                PoolObject<EventScheduler>::Instance().SetFlush(GetServerInterface(&channel));
+            if(bPause)
+                UpdateClientEvents(GetServerInterface(&channel));
         }
+        else if(bArm && flush)
+            return FlushClient(GetServerInterface(&channel));
+        else if(bArm || bPause)
+            UpdateClientEvents(GetServerInterface(&channel));
+        return 0;
+    }
 
-        IOBuffer ioRecvBuffer(&pInterface->m_Channel.Data.cPackageCache[pInterface->m_Channel.Data.dwCacheAvailableSize], 
-                              dwRemainSize);
-        pInterface->m_Channel >> ioRecvBuffer;
+    // SO_ZEROCOPY on the socket, the connection keeps its send queue from now.
+    bool EnableZeroCopy(ChannelType& channel)
+    {
+        int enable = 1;
+        if(-1 == setsockopt(channel.Socket, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(int)))
+            return false;
 
-        if(ioRecvBuffer.GetReadSize() == 0)
-        {
-            this->OnDisconnected(pInterface->m_Channel);
+        if(!channel.Data.pSendQueue)
+            channel.Data.pSendQueue = new TcpSendQueue();
+        channel.Data.pSendQueue->bZeroCopy = true;
+        UpdateClientEvents(GetServerInterface(&channel));
+        return true;
+    }
+
+    // Splice with output queued, the bytes are read into the queue.
+    ssize_t SpliceCopy(ChannelType& channel, int fd, size_t size)
+    {
+        char buffer[SERVER_SPLICE_SIZE];
+        ssize_t readSize = read(fd, buffer, (size < SERVER_SPLICE_SIZE) ? size : SERVER_SPLICE_SIZE);
+        if(readSize == 0 && size > 0)
+            return CHANNEL_CLOSED;
+        readSize = GetChannelStatus(readSize);
+        if(readSize > 0 && Send(channel, buffer, readSize) == -1)
+            return CHANNEL_ERROR;
+        return readSize;
+    }
+
+    // one part of a user buffer, MSG_ZEROCOPY takes a completion sequence
+    // for every send that moved bytes. out of notification memory the part
+    // is copied.
+    inline ssize_t SendZeroCopyChunk(int fd, TcpSendQueue* pQueue, TcpSendChunk& chunk)
+    {
+        const char* buffer = chunk.pBuffer + pQueue->dwOffset;
+        size_t size = chunk.dwSize - pQueue->dwOffset;
 
-            EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
-            scheduler.UnRegister(pInterface);
-            shutdown(pInterface->m_Channel.Socket, SHUT_RDWR);
-            close(pInterface->m_Channel.Socket);
-            delete pInterface;
+        ssize_t sendSize = ChannelSend(fd, buffer, size, MSG_DONTWAIT | MSG_NOSIGNAL | MSG_ZEROCOPY);
+        if(sendSize == CHANNEL_ERROR && errno == ENOBUFS)
+            return ChannelSend(fd, buffer, size);
+
+        if(sendSize > 0)
+        {
+            chunk.bZeroCopySent = true;
+            chunk.dwZeroCopySeq = pQueue->dwZeroCopySeq++;
+            __sync_fetch_and_add(&m_SendStats.ZeroCopyWrites, 1);
         }
-        else
+        return sendSize;
+    }
+
+    // drain MSG_ZEROCOPY completions from the socket error queue and release
+    // the completed user buffers. return the completions read, or -1 on an
+    // error queue entry that is not a completion.
+    int ReadZeroCopyCompletions(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
+    {
+        TcpSendQueue* pQueue = pInterface->m_Channel.Data.pSendQueue;
+
+        int count = 0;
+        while(true)
         {
-            pInterface->m_Channel.Data.dwCacheAvailableSize += ioRecvBuffer.GetReadSize();
+            char control[128];
+            msghdr msg;
+            bzero(&msg, sizeof(msghdr));
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
 
-            IOBuffer in(pInterface->m_Channel.Data.cPackageCache, 
-                        pInterface->m_Channel.Data.dwCacheAvailableSize,
-                        pInterface->m_Channel.Data.dwCacheAvailableSize);
-            this->OnMessage(pInterface->m_Channel, in);
+            if(recvmsg(pInterface->m_Channel.Socket, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1)
+                return count;
 
-            pInterface->m_Channel.Data.dwCacheAvailableSize = in.GetReadSize() - in.GetReadPosition();
-            if(in.GetReadPosition() > 0 && pInterface->m_Channel.Data.dwCacheAvailableSize > 0)
+            for(cmsghdr* pCmsg = CMSG_FIRSTHDR(&msg); pCmsg != NULL; pCmsg = CMSG_NXTHDR(&msg, pCmsg))
             {
-                memmove(pInterface->m_Channel.Data.cPackageCache, 
-                        &pInterface->m_Channel.Data.cPackageCache[in.GetReadPosition()],
-                        pInterface->m_Channel.Data.dwCacheAvailableSize);
+                if(!(pCmsg->cmsg_level == SOL_IP && pCmsg->cmsg_type == IP_RECVERR) &&
+                   !(pCmsg->cmsg_level == SOL_IPV6 && pCmsg->cmsg_type == IPV6_RECVERR))
+                    continue;
+
+                sock_extended_err* pErr = (sock_extended_err*)CMSG_DATA(pCmsg);
+                if(pErr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                {
+                    errno = pErr->ee_errno;
+                    return -1;
+                }
+
+                // sequences ee_info to ee_data are done.
+                if(pErr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                    __sync_fetch_and_add(&m_SendStats.ZeroCopyCopied, pErr->ee_data - pErr->ee_info + 1);
+                pQueue->Complete(pErr->ee_data);
+                ++count;
             }
         }
     }
 
-    void OnWriteable(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
-    {
-    }
-
     void OnErrorable(ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pInterface)
     {
+        // EPOLLERR also reports MSG_ZEROCOPY completions, the client is kept
+        // unless the socket has an error or hangup left once they are read.
+        TcpSendQueue* pQueue = pInterface->m_Channel.Data.pSendQueue;
+        if(pQueue && pQueue->bClosing)
+        {
+            // a disconnected client, closed with its last completion. error
+            // queue entries that are no completion are skipped.
+            while(ReadZeroCopyCompletions(pInterface) == -1)
+                ;
+
+            if(!pQueue->HasZeroCopyInFlight())
+            {
+                PoolObject<EventScheduler>::Instance().UnRegister(pInterface);
+                close(pInterface->m_Channel.Socket);
+                FreeClient(pInterface);
+            }
+            return;
+        }
+
+        if(pQueue && pQueue->bZeroCopy && ReadZeroCopyCompletions(pInterface) > 0)
+        {
+            pollfd pfd;
+            pfd.fd = pInterface->m_Channel.Socket;
+            pfd.events = 0;
+            pfd.revents = 0;
+            if(poll(&pfd, 1, 0) == 0)
+                return;
+        }
+
         this->OnError(pInterface->m_Channel);
         this->DisconnectClient(pInterface->m_Channel);
     }
 
     // udp server interface
-    TcpServer()
+    TcpServer() :
+        m_dwEventFlags(0),
+        m_dwWakeupBudget(SERVER_WAKEUP_BUDGET),
+        m_dwAcceptBudget(SERVER_WAKEUP_BUDGET),
+        m_dwByteBudget(SERVER_BYTE_BUDGET),
+        m_bReusePort(false),
+        m_bCpuSteering(false),
+        m_bExclusive(false),
+        m_bAcceptor(false),
+        m_dwHighWatermark(SERVER_SEND_HIGH_WATERMARK),
+        m_dwLowWatermark(SERVER_SEND_LOW_WATERMARK),
+        m_bDeferredFlush(false),
+        m_bCork(false),
+        m_dwMaxBufferSize(SERVER_MAX_BUFFER_SIZE)
     {
+        bzero(&m_SendStats, sizeof(TcpSendStats));
+        bzero(&m_AcceptStats, sizeof(TcpAcceptStats));
+
 #ifdef __USE_GNU
         m_ServerInterface.m_Channel.Socket = socket(PF_INET, SOCK_STREAM|SOCK_CLOEXEC, 0);
         if(m_ServerInterface.m_Channel.Socket == -1)
@@ -197,6 +1474,75 @@ public:
         m_ServerInterface.m_ReadableCallback = boost::bind(&ServerImplT::OnAcceptable, this, _1);
     }
 
+    // edge-triggered registration, the listener and the accepted sockets are
+    // non-blocking and drained up to budget reads or accepts per wakeup.
+    int SetEdgeTriggered(bool enable, uint32_t budget = SERVER_WAKEUP_BUDGET)
+    {
+        if(!enable)
+        {
+            m_dwEventFlags = 0;
+            return 0;
+        }
+
+        if(m_ServerInterface.m_Channel.Socket != -1 && SetNonblockFd(m_ServerInterface.m_Channel.Socket) < 0)
+            return -1;
+
+        m_dwEventFlags = EventScheduler::PollType::ET;
+        m_dwWakeupBudget = (budget == 0) ? 1 : budget;
+        return 0;
+    }
+
+    // per wakeup fairness in edge-triggered mode, a connection stops after
+    // reads or bytes, the listener after accepts, and the rest is picked up
+    // from the scheduler ready list before it blocks again.
+    void SetWakeupBudget(uint32_t reads, uint32_t bytes, uint32_t accepts)
+    {
+        m_dwWakeupBudget = (reads == 0) ? 1 : reads;
+        m_dwByteBudget = (bytes == 0) ? 1 : bytes;
+        m_dwAcceptBudget = (accepts == 0) ? 1 : accepts;
+    }
+
+    inline uint32_t GetEventFlags()
+    {
+        return m_dwEventFlags;
+    }
+
+    // every worker listens on its own socket from CreateListener instead of
+    // the shared one, see TcpServerStartup.
+    inline void SetReusePort(bool enable, bool cpuSteering = false)
+    {
+        m_bReusePort = enable;
+        m_bCpuSteering = cpuSteering;
+    }
+
+    inline bool IsReusePort()
+    {
+        return m_bReusePort;
+    }
+
+    // the shared listener wakes one worker per connection, the listener is
+    // non-blocking so a worker woken for nothing does not hang in accept.
+    int SetExclusive(bool enable)
+    {
+        if(enable && m_ServerInterface.m_Channel.Socket != -1 && SetNonblockFd(m_ServerInterface.m_Channel.Socket) < 0)
+            return -1;
+
+        m_bExclusive = enable;
+        return 0;
+    }
+
+    inline uint32_t GetListenEventFlags()
+    {
+        uint32_t flags = m_dwEventFlags | EventScheduler::PollType::ACCEPT;
+        return m_bExclusive ? (flags | EventScheduler::PollType::EXCLUSIVE) : flags;
+    }
+
+    // counted by every worker of the process, per worker with ProcessPool.
+    inline TcpAcceptStats& GetAcceptStats()
+    {
+        return m_AcceptStats;
+    }
+
     virtual ~TcpServer()
     {
     }
@@ -217,18 +1563,266 @@ public:
     {
     }
 
+    // send through the connection send queue. what the socket does not take
+    // now is queued and flushed when it becomes writeable, the loop never
+    // blocks. return the size, or -1 on a send error, the client is then
+    // cleaned up by the error or read path.
+    ssize_t Send(ChannelType& channel, const char* buffer, size_t size)
+    {
+        TcpSendQueue* pQueue = channel.Data.pSendQueue;
+
+        size_t sendSize = 0;
+        if((!pQueue || pQueue->dwPendingSize == 0) && !m_bDeferredFlush)
+        {
+            ssize_t iRet = ChannelSend(channel.Socket, buffer, size);
+            if(iRet == CHANNEL_AGAIN)
+                iRet = 0;
+            else if(iRet < 0)
+                return -1;
+
+            if((size_t)iRet == size)
+                return size;
+
+            sendSize = iRet;
+        }
+
+        if(!pQueue)
+            pQueue = channel.Data.pSendQueue = new TcpSendQueue();
+
+        // small replies share a chunk, one iovec each for big ones.
+        if(!pQueue->Chunks.empty() &&
+           pQueue->Chunks.back().Type == TcpSendChunk::SEND_DATA &&
+           pQueue->Chunks.back().Data.size() + size - sendSize <= SERVER_SEND_CHUNK_SIZE)
+            pQueue->Chunks.back().Data.append(buffer + sendSize, size - sendSize);
+        else
+        {
+            pQueue->Chunks.push_back(TcpSendChunk(TcpSendChunk::SEND_DATA));
+            pQueue->Chunks.back().Data.assign(buffer + sendSize, size - sendSize);
+        }
+
+        OnSendQueued(channel, pQueue, size - sendSize, false);
+        return size;
+    }
+
+    // send size bytes of the file fd from offset with sendfile, in order with
+    // the other output of the connection. the region is sent from a dup of
+    // fd, the caller may close fd on return. return size or -1 on an error.
+    ssize_t SendFile(ChannelType& channel, int fd, off_t offset, size_t size)
+    {
+        if(size == 0)
+            return 0;
+
+        TcpSendQueue* pQueue = channel.Data.pSendQueue;
+
+        size_t sendSize = 0;
+        if((!pQueue || pQueue->dwPendingSize == 0) && !m_bDeferredFlush)
+        {
+            TcpNonblockScope nonblock(channel.Socket, !(m_dwEventFlags & EventScheduler::PollType::ET));
+            if(nonblock.Flags == -1)
+                return -1;
+
+            while(sendSize < size)
+            {
+                ssize_t iRet = ChannelSendFile(channel.Socket, fd, &offset, size - sendSize);
+                if(iRet == CHANNEL_AGAIN)
+                    break;
+                if(iRet < 0)
+                    return -1;
+                __sync_fetch_and_add(&m_SendStats.Writes, 1);
+                __sync_fetch_and_add(&m_SendStats.Bytes, iRet);
+                sendSize += iRet;
+            }
+
+            if(sendSize == size)
+                return size;
+        }
+
+        int filefd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if(filefd == -1)
+            return -1;
+
+        if(!pQueue)
+            pQueue = channel.Data.pSendQueue = new TcpSendQueue();
+
+        pQueue->Chunks.push_back(TcpSendChunk(TcpSendChunk::SEND_FILE));
+        pQueue->Chunks.back().Fd = filefd;
+        pQueue->Chunks.back().Offset = offset;
+        pQueue->Chunks.back().dwSize = size - sendSize;
+
+        OnSendQueued(channel, pQueue, size - sendSize, false);
+        return size;
+    }
+
+    // send a user buffer with MSG_ZEROCOPY, the pages are not copied but the
+    // buffer must stay unchanged until release is called. that happens from
+    // the loop once the completion is read from the socket error queue on
+    // EPOLLERR, or when the client is cleaned up, and release must not send
+    // on the connection. sockets without SO_ZEROCOPY and small buffers are
+    // copied and released at once. return size or -1.
+    ssize_t SendZeroCopy(ChannelType& channel, const char* buffer, size_t size, boost::function<void(void)> release)
+    {
+        TcpSendQueue* pQueue = channel.Data.pSendQueue;
+        if(size < SERVER_ZEROCOPY_MIN_SIZE || !((pQueue && pQueue->bZeroCopy) || EnableZeroCopy(channel)))
+        {
+            ssize_t iRet = Send(channel, buffer, size);
+            if(release)
+                release();
+            return iRet;
+        }
+
+        pQueue = channel.Data.pSendQueue;
+        pQueue->Chunks.push_back(TcpSendChunk(TcpSendChunk::SEND_ZEROCOPY));
+        pQueue->Chunks.back().pBuffer = buffer;
+        pQueue->Chunks.back().dwSize = size;
+        pQueue->Chunks.back().Release = release;
+
+        if(OnSendQueued(channel, pQueue, size, true) == -1)
+            return -1;
+        return size;
+    }
+
+    // move up to size bytes readable on fd, a socket or a pipe, to the client
+    // through the pipe of the worker, the bytes do not pass user space. what
+    // the client does not take is read back from the pipe into the send
+    // queue, the pipe is empty between calls. with output queued already the
+    // bytes are copied through the queue to keep the order. fd should be
+    // non-blocking. return the bytes taken from fd or a ChannelStatus,
+    // CHANNEL_CLOSED at the end of fd.
+    ssize_t Splice(ChannelType& channel, int fd, size_t size)
+    {
+        TcpSplicePipe& pipe = PoolObject<TcpSplicePipe>::Instance();
+        if(m_bDeferredFlush || GetPendingSize(channel) > 0 || pipe.Open() == -1)
+            return SpliceCopy(channel, fd, size);
+
+        TcpNonblockScope nonblock(channel.Socket, !(m_dwEventFlags & EventScheduler::PollType::ET));
+        if(nonblock.Flags == -1)
+            return SpliceCopy(channel, fd, size);
+
+        size_t spliceSize = 0;
+        while(spliceSize < size)
+        {
+            ssize_t inSize = ChannelSplice(fd, pipe.Fds[1], (size - spliceSize < SERVER_SPLICE_SIZE) ? size - spliceSize : SERVER_SPLICE_SIZE);
+            if(inSize < 0)
+                return (spliceSize > 0) ? (ssize_t)spliceSize : inSize;
+            spliceSize += inSize;
+
+            while(inSize > 0)
+            {
+                ssize_t outSize = ChannelSplice(pipe.Fds[0], channel.Socket, inSize);
+                if(outSize == CHANNEL_AGAIN)
+                {
+                    // the client is full, the rest waits in the send queue.
+                    std::string strLeft(inSize, '\0');
+                    size_t readSize = 0;
+                    while(readSize < strLeft.size())
+                    {
+                        ssize_t iRet = read(pipe.Fds[0], &strLeft[readSize], strLeft.size() - readSize);
+                        if(iRet <= 0)
+                            break;
+                        readSize += iRet;
+                    }
+                    if(Send(channel, strLeft.data(), readSize) == -1)
+                        return CHANNEL_ERROR;
+                    return spliceSize;
+                }
+                if(outSize < 0)
+                {
+                    int error = errno;
+                    pipe.Drain();
+                    errno = error;
+                    return CHANNEL_ERROR;
+                }
+
+                __sync_fetch_and_add(&m_SendStats.Writes, 1);
+                __sync_fetch_and_add(&m_SendStats.Bytes, outSize);
+                inSize -= outSize;
+            }
+        }
+        return spliceSize;
+    }
+
+    // replies are queued and written once per connection at the end of the
+    // loop iteration, optionally between TCP_CORK and uncork.
+    inline void SetDeferredFlush(bool enable, bool cork = false)
+    {
+        m_bDeferredFlush = enable;
+        m_bCork = enable && cork;
+    }
+
+    // writes of the send queue and the bytes they sent, per process.
+    inline TcpSendStats& GetSendStats()
+    {
+        return m_SendStats;
+    }
+
+    inline ssize_t Send(ChannelType& channel, IOBuffer& out)
+    {
+        ssize_t iRet = Send(channel, out.GetWriteBuffer(), out.GetWritePosition());
+        if(iRet != -1)
+            out.m_WritePosition = 0;
+        return iRet;
+    }
+
+    // channel << out of a client.
+    virtual ssize_t SendChannel(ChannelType& channel, const char* buffer, size_t size)
+    {
+        return Send(channel, buffer, size);
+    }
+
+    inline size_t GetPendingSize(ChannelType& channel)
+    {
+        return channel.Data.pSendQueue ? channel.Data.pSendQueue->dwPendingSize : 0;
+    }
+
+    // reading from a client pauses at high pending send bytes and resumes at low.
+    inline void SetSendWatermark(uint32_t high, uint32_t low)
+    {
+        m_dwHighWatermark = (high == 0) ? 1 : high;
+        m_dwLowWatermark = (low > m_dwHighWatermark) ? m_dwHighWatermark : low;
+    }
+
     void DisconnectClient(ChannelType& channel)
     {
         this->OnDisconnected(channel);
 
         ServerInterface<TcpChannelCache<ChannelDataT, CacheSize> >* pChannelInterface = GetServerInterface(&channel);
-        PoolObject<EventScheduler>::Instance().UnRegister(pChannelInterface);
+        EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
+        scheduler.UnRegister(pChannelInterface);
         shutdown(pChannelInterface->m_Channel.Socket, SHUT_RDWR);
+        FreeCache(pChannelInterface->m_Channel.Data, boost::mpl::bool_<CacheSize == 0>());
+        RemoveClient();
+
+        // the kernel may still send from MSG_ZEROCOPY user buffers, the socket
+        // stays open for their completions on the error queue, see OnErrorable.
+        TcpSendQueue* pQueue = pChannelInterface->m_Channel.Data.pSendQueue;
+        if(pQueue && pQueue->HasZeroCopyInFlight() &&
+           0 == scheduler.Register(pChannelInterface, EventScheduler::PollType::ET))
+        {
+            pQueue->Drop();
+            return;
+        }
+
         close(pChannelInterface->m_Channel.Socket);
-        delete pChannelInterface;
+        FreeClient(pChannelInterface);
     }
 
     ServerInterface<void>   m_ServerInterface;
+    uint32_t                m_dwEventFlags;
+    uint32_t                m_dwWakeupBudget;
+    uint32_t                m_dwAcceptBudget;
+    uint32_t                m_dwByteBudget;
+    bool                    m_bReusePort;
+    bool                    m_bCpuSteering;
+    bool                    m_bExclusive;
+    TcpAcceptStats          m_AcceptStats;
+    bool                    m_bAcceptor;
+    std::vector<uint32_t>   m_WorkerConnections;
+    uint32_t                m_dwHighWatermark;
+    uint32_t                m_dwLowWatermark;
+    bool                    m_bDeferredFlush;
+    bool                    m_bCork;
+    TcpSendStats            m_SendStats;
+    uint32_t                m_dwMaxBufferSize;
 };
 
 #endif // define __TCPSERVER_HPP__
@@ -97,10 +97,8 @@ public:
     {
         EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
 
-        int timeout = scheduler.GetIdleTimeout();
-        if(timeout == -1 || timeout > Interval)
-            scheduler.SetIdleTimeout(Interval);
-
+        // the loop sleeps until the next expiry instead of polling every Interval.
+        scheduler.RegisterTimeoutCallback(boost::bind(&TimerBaseT::GetNextTimeout, reinterpret_cast<TimerBaseT*>(this)));
         scheduler.RegisterLoopCallback(boost::bind(&TimerBaseT::CheckTimer, reinterpret_cast<TimerBaseT*>(this)));
         return true;
     }
@@ -114,6 +112,10 @@ protected:
     IdT m_LastTimerId;
     TimeValueT m_LastTimeval;
 
+    // cached tick of the nearest expiry, it may be earlier than the real one.
+    bool m_bNextTimevalValid;
+    TimeValueT m_NextTimeval;
+
 #define TVN_BITS    6
 #define TVR_BITS    8
 #define TVN_SIZE    (1 << TVN_BITS)
@@ -174,6 +176,9 @@ protected:
 
         pItem->Base = ppVector;
 
+        if(m_bNextTimevalValid && pItem->Timeval < m_NextTimeval)
+            m_NextTimeval = pItem->Timeval;
+
         if(ppVector[0] == NULL)
             ppVector[0] = pItem;
         else
@@ -233,7 +238,9 @@ protected:
 
 public:
     TimerBase() :
-        m_LastTimerId(0)
+        m_LastTimerId(0),
+        m_bNextTimevalValid(false),
+        m_NextTimeval(0)
     {
         m_LastTimeval = GetTimeval();
 
@@ -294,9 +301,41 @@ public:
         m_TimerDataMap.erase(iter);
     }
 
+    // milliseconds until the next timer expiry, -1 if there is no timer.
+    int GetNextTimeout()
+    {
+        if(m_TimerDataMap.empty())
+            return -1;
+
+        if(!m_bNextTimevalValid)
+        {
+            // first non-empty slot of the nearest 256 ticks, or the next cascade.
+            TimeValueT tick = m_LastTimeval;
+            for(int i = 0; i < TVR_SIZE; ++i, ++tick)
+            {
+                if(m_Vector1[tick & TVR_MASK] != NULL || (i > 0 && (tick & TVR_MASK) == 0))
+                    break;
+            }
+            m_NextTimeval = tick;
+            m_bNextTimevalValid = true;
+        }
+
+        // the tick is handled once the clock passes it.
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        int64_t now = tv.tv_sec * 1000 + tv.tv_usec / 1000;
+        int64_t timeout = (int64_t)(m_NextTimeval + 1) * Interval - now;
+        if(timeout < 0)
+            return 0;
+        return (int)timeout;
+    }
+
     void CheckTimer()
     {
         TimeValueT now = GetTimeval();
+        if(m_LastTimeval < now)
+            m_bNextTimevalValid = false;
+
         while(m_LastTimeval < now)
         {
             TimeValueT index = m_LastTimeval & TVR_MASK;
@@ -0,0 +1,468 @@
+/*++
+ *
+ * Simple Server Library
+ * Author: NickeyWoo
+ * Date: 2026-10-17
+ *
+--*/
+#ifndef __UDPCLIENT_HPP__
+#define __UDPCLIENT_HPP__
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+#include "Channel.hpp"
+#include "Server.hpp"
+#include "IOBuffer.hpp"
+#include "PoolObject.hpp"
+#include "ObjectPool.hpp"
+#include "Pool.hpp"
+#include "EventScheduler.hpp"
+#include "Timer.hpp"
+
+#ifndef UDPCLIENT_MAX_REQUEST_SIZE
+    // bytes of an encoded request, kept for the retransmits
+    #define UDPCLIENT_MAX_REQUEST_SIZE      1472
+#endif
+
+#ifndef UDPCLIENT_MAX_REQUESTS
+    // requests in flight per client, a power of 2
+    #define UDPCLIENT_MAX_REQUESTS          4096
+#endif
+
+#ifndef UDPCLIENT_BATCH
+    // datagrams per sendmmsg or recvmmsg
+    #define UDPCLIENT_BATCH                 32
+#endif
+
+#ifndef UDPCLIENT_SLOT_SIZE
+    // bytes of a response slot, longer responses are dropped
+    #define UDPCLIENT_SLOT_SIZE             65535
+#endif
+
+#ifndef UDPCLIENT_TIMEOUT
+    // milliseconds until a request fails
+    #define UDPCLIENT_TIMEOUT               200
+#endif
+
+#ifndef UDPCLIENT_RETRANSMIT_TIMEOUT
+    // milliseconds until the first retransmit, doubled for every next one
+    #define UDPCLIENT_RETRANSMIT_TIMEOUT    50
+#endif
+
+#ifndef UDPCLIENT_RETRIES
+    #define UDPCLIENT_RETRIES               2
+#endif
+
+// a request in flight, from the slab pool of the worker.
+struct UdpRequest
+{
+    uint32_t                                    dwToken;
+    sockaddr_in                                 Target;
+    uint32_t                                    dwRetries;              // retransmits left
+    uint32_t                                    dwRetransmitTimeout;
+    uint32_t                                    dwTimeLeft;             // milliseconds until the request fails
+    uint32_t                                    dwTimerInterval;        // of the running timer
+    Timer<UdpRequest*>::TimerID                 dwTimerId;
+    boost::function<void(uint32_t, IOBuffer*)>  Callback;
+    uint32_t                                    dwSize;
+    char                                        Data[UDPCLIENT_MAX_REQUEST_SIZE];
+};
+
+struct UdpClientStats
+{
+    uint64_t Requests;
+    uint64_t Responses;
+    uint64_t Timeouts;
+    uint64_t Retransmits;
+    uint64_t Rejected;      // no free token or the request is too long
+    uint64_t Stale;         // responses without a request in flight, late or spoofed
+    uint64_t Reads;         // recvmmsg calls
+    uint64_t Writes;        // sendmmsg calls
+    uint64_t SendErrors;
+};
+
+//
+// asynchronous udp requests to any number of peers over one socket. a request
+// gets a token like Session::Allocate, the token goes out in the request and
+// comes back in the response, which completes the request. requests are
+// retransmitted with a doubling timeout until they are answered or their
+// timeout is over, the callback then gets the response or NULL. the requests
+// of a loop iteration go out with one sendmmsg at its end.
+//
+// the default encoding puts the token in front of the data as 4 bytes in
+// network order and expects it back in front of the response, override
+// EncodeRequest and DecodeResponse for other protocols.
+//
+template<typename ClientImplT>
+class UdpClient
+{
+public:
+    typedef Channel<void> ChannelType;
+    typedef uint32_t Token;
+    typedef boost::function<void(Token, IOBuffer*)> CallbackType;
+
+    UdpClient() :
+        m_dwEventFlags(0),
+        m_dwSequence(0),
+        m_dwRetransmitTimeout(UDPCLIENT_RETRANSMIT_TIMEOUT),
+        m_Requests(UDPCLIENT_MAX_REQUESTS, (UdpRequest*)NULL),
+        m_dwRequestMask(UDPCLIENT_MAX_REQUESTS - 1),
+        m_RecvBuffer((size_t)UDPCLIENT_BATCH * UDPCLIENT_SLOT_SIZE)
+    {
+        bzero(&m_Stats, sizeof(UdpClientStats));
+        bzero(m_RecvMsgs, sizeof(m_RecvMsgs));
+        bzero(m_SendMsgs, sizeof(m_SendMsgs));
+        for(int i = 0; i < UDPCLIENT_BATCH; ++i)
+        {
+            m_RecvIov[i].iov_base = &m_RecvBuffer[(size_t)i * UDPCLIENT_SLOT_SIZE];
+            m_RecvIov[i].iov_len = UDPCLIENT_SLOT_SIZE;
+            m_RecvMsgs[i].msg_hdr.msg_iov = &m_RecvIov[i];
+            m_RecvMsgs[i].msg_hdr.msg_iovlen = 1;
+
+            m_SendMsgs[i].msg_hdr.msg_iov = &m_SendIov[i];
+            m_SendMsgs[i].msg_hdr.msg_iovlen = 1;
+            m_SendMsgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        }
+
+#ifdef __USE_GNU
+        m_ServerInterface.m_Channel.Socket = socket(PF_INET, SOCK_DGRAM|SOCK_CLOEXEC, 0);
+        if(m_ServerInterface.m_Channel.Socket == -1)
+            return;
+#else
+        m_ServerInterface.m_Channel.Socket = socket(PF_INET, SOCK_DGRAM, 0);
+        if(m_ServerInterface.m_Channel.Socket == -1)
+            return;
+
+        if(SetCloexecFd(m_ServerInterface.m_Channel.Socket) < 0)
+        {
+            close(m_ServerInterface.m_Channel.Socket);
+            m_ServerInterface.m_Channel.Socket = -1;
+            return;
+        }
+#endif
+        m_ServerInterface.SetHandler(reinterpret_cast<ClientImplT*>(this));
+    }
+
+    // the requests in flight are dropped without their callbacks.
+    virtual ~UdpClient()
+    {
+        for(size_t i = 0; i < m_Requests.size(); ++i)
+        {
+            if(m_Requests[i])
+                FreeRequest(m_Requests[i]);
+        }
+
+        if(m_ServerInterface.m_Channel.Socket != -1)
+            close(m_ServerInterface.m_Channel.Socket);
+    }
+
+    // bind to local if given and register with the scheduler of the worker.
+    int Open(sockaddr_in* local = NULL)
+    {
+        if(m_ServerInterface.m_Channel.Socket == -1)
+            return -1;
+
+        if(local && -1 == bind(m_ServerInterface.m_Channel.Socket, (sockaddr*)local, sizeof(sockaddr_in)))
+            return -1;
+
+        return PoolObject<EventScheduler>::Instance().Register(this, EventScheduler::PollType::IN | m_dwEventFlags);
+    }
+
+    // edge-triggered registration, set before Open.
+    inline void SetEdgeTriggered(bool enable)
+    {
+        m_dwEventFlags = enable ? EventScheduler::PollType::ET : 0;
+    }
+
+    // requests in flight, rounded up to a power of 2, not with requests in flight.
+    void SetMaxRequests(uint32_t count)
+    {
+        uint32_t size = 1;
+        while(size < count)
+            size <<= 1;
+
+        m_Requests.assign(size, (UdpRequest*)NULL);
+        m_dwRequestMask = size - 1;
+    }
+
+    inline void SetRetransmitTimeout(uint32_t timeout)
+    {
+        m_dwRetransmitTimeout = (timeout == 0) ? 1 : timeout;
+    }
+
+    inline UdpClientStats& GetStats()
+    {
+        return m_Stats;
+    }
+
+    // send a request to target, callback gets the response or NULL once
+    // timeout milliseconds are over. return the token, 0 if the request is
+    // too long or too many are in flight.
+    Token Request(sockaddr_in& target, const char* buffer, size_t size, CallbackType callback,
+                  uint32_t timeout = UDPCLIENT_TIMEOUT, uint32_t retries = UDPCLIENT_RETRIES)
+    {
+        Token token = AllocateToken();
+        if(token == 0)
+        {
+            ++m_Stats.Rejected;
+            return 0;
+        }
+
+        UdpRequest* pRequest = PoolObject<ObjectPool<UdpRequest> >::Instance().Alloc();
+        if(!pRequest)
+        {
+            ++m_Stats.Rejected;
+            return 0;
+        }
+
+        pRequest->dwSize = this->EncodeRequest(pRequest->Data, UDPCLIENT_MAX_REQUEST_SIZE, token, buffer, size);
+        if(pRequest->dwSize == 0)
+        {
+            PoolObject<ObjectPool<UdpRequest> >::Instance().Free(pRequest);
+            ++m_Stats.Rejected;
+            return 0;
+        }
+
+        pRequest->dwToken = token;
+        pRequest->Target = target;
+        pRequest->dwRetries = retries;
+        pRequest->dwRetransmitTimeout = m_dwRetransmitTimeout;
+        pRequest->dwTimeLeft = (timeout == 0) ? 1 : timeout;
+        pRequest->Callback = callback;
+        m_Requests[token & m_dwRequestMask] = pRequest;
+
+        ++m_Stats.Requests;
+        StartTimer(pRequest);
+        QueueSend(pRequest);
+        return token;
+    }
+
+    // the token in front of the data.
+    virtual size_t EncodeRequest(char* buffer, size_t capacity, Token token, const char* data, size_t size)
+    {
+        if(size + sizeof(Token) > capacity)
+            return 0;
+
+        token = htonl(token);
+        memcpy(buffer, &token, sizeof(Token));
+        memcpy(buffer + sizeof(Token), data, size);
+        return size + sizeof(Token);
+    }
+
+    // read the token, in is left at the response data.
+    virtual bool DecodeResponse(IOBuffer& in, Token& token)
+    {
+        if(in.GetReadSize() < sizeof(Token) || in.Read((char*)&token, sizeof(Token)) == 0)
+            return false;
+
+        token = ntohl(token);
+        return true;
+    }
+
+    void OnReadable(ServerInterface<void>* pInterface)
+    {
+        // edge-triggered, read until a batch comes back short.
+        while(ReadResponses(pInterface) == UDPCLIENT_BATCH && (m_dwEventFlags & EventScheduler::PollType::ET))
+            ;
+    }
+
+    void OnWriteable(ServerInterface<void>* pInterface)
+    {
+        FlushSends();
+    }
+
+    void OnErrorable(ServerInterface<void>* pInterface)
+    {
+        // fetch and clear the pending icmp error, the request times out.
+        pInterface->m_Channel.GetErrorCode();
+    }
+
+    int ReadResponses(ServerInterface<void>* pInterface)
+    {
+        sockaddr_in addrs[UDPCLIENT_BATCH];
+        for(int i = 0; i < UDPCLIENT_BATCH; ++i)
+        {
+            m_RecvMsgs[i].msg_hdr.msg_name = &addrs[i];
+            m_RecvMsgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            m_RecvMsgs[i].msg_hdr.msg_flags = 0;
+        }
+
+        int iRet = recvmmsg(pInterface->m_Channel.Socket, m_RecvMsgs, UDPCLIENT_BATCH, MSG_DONTWAIT, NULL);
+        ++m_Stats.Reads;
+        if(iRet <= 0)
+            return 0;
+
+        for(int i = 0; i < iRet; ++i)
+        {
+            if(m_RecvMsgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+            {
+                ++m_Stats.Stale;
+                continue;
+            }
+
+            IOBuffer in((char*)m_RecvIov[i].iov_base, UDPCLIENT_SLOT_SIZE, m_RecvMsgs[i].msg_len);
+
+            Token token = 0;
+            UdpRequest* pRequest = NULL;
+            if(this->DecodeResponse(in, token))
+                pRequest = m_Requests[token & m_dwRequestMask];
+
+            // only the peer of the request can answer it.
+            if(!pRequest || pRequest->dwToken != token ||
+               pRequest->Target.sin_addr.s_addr != addrs[i].sin_addr.s_addr ||
+               pRequest->Target.sin_port != addrs[i].sin_port)
+            {
+                ++m_Stats.Stale;
+                continue;
+            }
+
+            ++m_Stats.Responses;
+            PoolObject<Timer<UdpRequest*> >::Instance().Clear(pRequest->dwTimerId);
+            Complete(pRequest, &in);
+        }
+        return iRet;
+    }
+
+    void OnRequestTimeout(UdpRequest* pRequest)
+    {
+        pRequest->dwTimeLeft -= pRequest->dwTimerInterval;
+        if(pRequest->dwTimeLeft == 0 || pRequest->dwRetries == 0)
+        {
+            ++m_Stats.Timeouts;
+            Complete(pRequest, NULL);
+            return;
+        }
+
+        --pRequest->dwRetries;
+        pRequest->dwRetransmitTimeout <<= 1;
+        ++m_Stats.Retransmits;
+
+        StartTimer(pRequest);
+        QueueSend(pRequest);
+    }
+
+    // send the queued requests, the ones the socket does not take are left
+    // to their retransmit.
+    void FlushSends()
+    {
+        int count = 0;
+        for(size_t i = 0; i < m_SendQueue.size(); ++i)
+        {
+            // completed or timed out since it was queued.
+            UdpRequest* pRequest = m_Requests[m_SendQueue[i] & m_dwRequestMask];
+            if(!pRequest || pRequest->dwToken != m_SendQueue[i])
+                continue;
+
+            m_SendIov[count].iov_base = pRequest->Data;
+            m_SendIov[count].iov_len = pRequest->dwSize;
+            m_SendMsgs[count].msg_hdr.msg_name = &pRequest->Target;
+            ++count;
+
+            if(count == UDPCLIENT_BATCH || i + 1 == m_SendQueue.size())
+            {
+                SendBatch(count);
+                count = 0;
+            }
+        }
+        m_SendQueue.clear();
+    }
+
+    ServerInterface<void> m_ServerInterface;
+    uint32_t m_dwEventFlags;
+
+private:
+    Token AllocateToken()
+    {
+        // the next sequence whose slot is free, 0 is no token.
+        for(size_t i = 0; i < m_Requests.size(); ++i)
+        {
+            Token token = ++m_dwSequence;
+            if(token != 0 && m_Requests[token & m_dwRequestMask] == NULL)
+                return token;
+        }
+        return 0;
+    }
+
+    void StartTimer(UdpRequest* pRequest)
+    {
+        uint32_t interval = pRequest->dwTimeLeft;
+        if(pRequest->dwRetries > 0 && pRequest->dwRetransmitTimeout < interval)
+            interval = pRequest->dwRetransmitTimeout;
+
+        pRequest->dwTimerInterval = interval;
+        pRequest->dwTimerId = PoolObject<Timer<UdpRequest*> >::Instance().SetTimeout(
+                                    boost::bind(&UdpClient<ClientImplT>::OnRequestTimeout, this, _1),
+                                    interval, pRequest);
+    }
+
+    inline void QueueSend(UdpRequest* pRequest)
+    {
+        if(m_SendQueue.empty())
+            PoolObject<EventScheduler>::Instance().SetFlush(this);
+        m_SendQueue.push_back(pRequest->dwToken);
+    }
+
+    void SendBatch(int count)
+    {
+        int sent = 0;
+        while(sent < count)
+        {
+            int iRet = sendmmsg(m_ServerInterface.m_Channel.Socket, &m_SendMsgs[sent], count - sent, MSG_DONTWAIT);
+            ++m_Stats.Writes;
+            if(iRet == -1)
+            {
+                if(errno == EINTR)
+                    continue;
+                if(errno == EAGAIN || errno == EWOULDBLOCK)
+                    return;
+                ++m_Stats.SendErrors;
+                iRet = 1;
+            }
+            sent += iRet;
+        }
+    }
+
+    // the request leaves the table before the callback, which may send the
+    // next one.
+    void Complete(UdpRequest* pRequest, IOBuffer* pResponse)
+    {
+        Token token = pRequest->dwToken;
+        CallbackType callback;
+        callback.swap(pRequest->Callback);
+
+        m_Requests[token & m_dwRequestMask] = NULL;
+        PoolObject<ObjectPool<UdpRequest> >::Instance().Free(pRequest);
+
+        if(callback)
+            callback(token, pResponse);
+    }
+
+    void FreeRequest(UdpRequest* pRequest)
+    {
+        PoolObject<Timer<UdpRequest*> >::Instance().Clear(pRequest->dwTimerId);
+        m_Requests[pRequest->dwToken & m_dwRequestMask] = NULL;
+        PoolObject<ObjectPool<UdpRequest> >::Instance().Free(pRequest);
+    }
+
+    Token m_dwSequence;
+    uint32_t m_dwRetransmitTimeout;
+    std::vector<UdpRequest*> m_Requests;
+    uint32_t m_dwRequestMask;
+    std::vector<Token> m_SendQueue;
+    UdpClientStats m_Stats;
+
+    std::vector<char> m_RecvBuffer;
+    mmsghdr m_RecvMsgs[UDPCLIENT_BATCH];
+    iovec m_RecvIov[UDPCLIENT_BATCH];
+    mmsghdr m_SendMsgs[UDPCLIENT_BATCH];
+    iovec m_SendIov[UDPCLIENT_BATCH];
+};
+
+#endif // define __UDPCLIENT_HPP__
+
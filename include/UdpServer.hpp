@@ -8,52 +8,460 @@
 #ifndef __UDPSERVER_HPP__
 #define __UDPSERVER_HPP__
 
+#include <stdlib.h>
 #include <utility>
 #include <string>
+#include <vector>
 #include <exception>
+#include <netinet/udp.h>
+#include <linux/filter.h>
 #include <boost/function.hpp>
 #include <boost/bind.hpp>
 #include "Channel.hpp"
 #include "Server.hpp"
 #include "IOBuffer.hpp"
+#include "PoolObject.hpp"
+#include "EventScheduler.hpp"
 #include "Clock.hpp"
 
+#ifndef UDPSERVER_BATCH_SLOT_SIZE
+    // bytes of a recvmmsg slot and of a queued reply, longer datagrams are
+    // dropped on receive and sent alone
+    #define UDPSERVER_BATCH_SLOT_SIZE   65535
+#endif
+
+#ifndef UDPSERVER_MAX_BATCH
+    // datagrams per recvmmsg or sendmmsg, the kernel limit UIO_MAXIOV
+    #define UDPSERVER_MAX_BATCH         1024
+#endif
+
+#ifndef UDPSERVER_GSO_MAX_SEGMENTS
+    // datagrams per UDP_SEGMENT send, the kernel limit UDP_MAX_SEGMENTS
+    #define UDPSERVER_GSO_MAX_SEGMENTS  64
+#endif
+
+#ifndef UDP_SEGMENT
+    #define UDP_SEGMENT                 103
+#endif
+
+#ifndef UDP_GRO
+    #define UDP_GRO                     104
+#endif
+
+// the largest udp payload over ipv4.
+#define UDPSERVER_MAX_PAYLOAD           65507
+
+// room for the UDP_GRO and SO_RXQ_OVFL cmsgs of a read.
+#define UDPSERVER_CONTROL_SIZE          (CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(uint32_t)))
+
+// counted per worker server.
+struct UdpServerStats
+{
+    uint64_t Reads;         // recvmsg or recvmmsg calls
+    uint64_t Messages;      // datagrams to OnMessage, GRO segments each
+    uint64_t Truncated;     // datagrams longer than a slot
+    uint64_t Coalesced;     // reads that held more than one GRO segment
+    uint64_t Writes;        // sendto, sendmsg or sendmmsg calls
+    uint64_t Sends;
+    uint64_t SendErrors;
+    uint64_t Drops;         // SO_RXQ_OVFL, datagrams the kernel dropped on a full receive buffer
+};
+
+// the segment size of a GRO read, 0 for a single datagram. the drop count of
+// the socket is kept in drops if the read carries one.
+inline uint16_t ReadUdpControl(msghdr& msg, uint64_t& drops)
+{
+    uint16_t segmentSize = 0;
+    for(cmsghdr* pCmsg = CMSG_FIRSTHDR(&msg); pCmsg != NULL; pCmsg = CMSG_NXTHDR(&msg, pCmsg))
+    {
+        if(pCmsg->cmsg_level == SOL_UDP && pCmsg->cmsg_type == UDP_GRO)
+            segmentSize = (uint16_t)*(int*)CMSG_DATA(pCmsg);
+        else if(pCmsg->cmsg_level == SOL_SOCKET && pCmsg->cmsg_type == SO_RXQ_OVFL)
+            drops = *(uint32_t*)CMSG_DATA(pCmsg);
+    }
+    return segmentSize;
+}
+
+//
+// recvmmsg slots and the replies queued while a batch is dispatched,
+// allocated once by SetBatch.
+//
+struct UdpBatch
+{
+    uint32_t                    dwSize;
+    uint32_t                    dwSlotSize;
+    char*                       pRecvBuffer;
+    char*                       pSendBuffer;
+    std::vector<mmsghdr>        RecvMsgs;
+    std::vector<iovec>          RecvIov;
+    std::vector<sockaddr_in>    RecvAddrs;
+    std::vector<char>           RecvControl;    // the cmsgs of every slot
+    std::vector<mmsghdr>        SendMsgs;
+    std::vector<iovec>          SendIov;
+    std::vector<sockaddr_in>    SendAddrs;
+    uint32_t                    dwSendCount;
+    bool                        bDispatching;
+
+    UdpBatch(uint32_t size, uint32_t slotSize) :
+        dwSize(size),
+        dwSlotSize(slotSize),
+        pRecvBuffer((char*)malloc((size_t)size * slotSize)),
+        pSendBuffer((char*)malloc((size_t)size * slotSize)),
+        RecvMsgs(size),
+        RecvIov(size),
+        RecvAddrs(size),
+        RecvControl((size_t)size * UDPSERVER_CONTROL_SIZE),
+        SendMsgs(size),
+        SendIov(size),
+        SendAddrs(size),
+        dwSendCount(0),
+        bDispatching(false)
+    {
+        bzero(&RecvMsgs[0], size * sizeof(mmsghdr));
+        bzero(&SendMsgs[0], size * sizeof(mmsghdr));
+        for(uint32_t i = 0; i < size; ++i)
+        {
+            RecvIov[i].iov_base = pRecvBuffer + (size_t)i * slotSize;
+            RecvIov[i].iov_len = slotSize;
+            RecvMsgs[i].msg_hdr.msg_iov = &RecvIov[i];
+            RecvMsgs[i].msg_hdr.msg_iovlen = 1;
+
+            SendIov[i].iov_base = pSendBuffer + (size_t)i * slotSize;
+            SendMsgs[i].msg_hdr.msg_iov = &SendIov[i];
+            SendMsgs[i].msg_hdr.msg_iovlen = 1;
+            SendMsgs[i].msg_hdr.msg_name = &SendAddrs[i];
+            SendMsgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        }
+    }
+
+    ~UdpBatch()
+    {
+        free(pRecvBuffer);
+        free(pSendBuffer);
+    }
+
+    // msg_namelen, msg_controllen and msg_flags are results, reset before
+    // every recvmmsg.
+    inline void ResetRecv(uint32_t count, bool control)
+    {
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            RecvMsgs[i].msg_hdr.msg_name = &RecvAddrs[i];
+            RecvMsgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            RecvMsgs[i].msg_hdr.msg_flags = 0;
+            if(control)
+            {
+                RecvMsgs[i].msg_hdr.msg_control = &RecvControl[i * UDPSERVER_CONTROL_SIZE];
+                RecvMsgs[i].msg_hdr.msg_controllen = UDPSERVER_CONTROL_SIZE;
+            }
+        }
+    }
+};
+
 template<typename ServerImplT, typename ChannelDataT = void>
 class UdpServer
 {
 public:
     typedef Channel<ChannelDataT> ChannelType;
 
+    // with reuseport every worker binds the same port and the kernel hashes
+    // the flows over the sockets of the group. with cpu steering a datagram
+    // goes to the socket whose index in the group is the cpu that received
+    // it, which assumes worker N binds N-th and runs on cpu N. an index past
+    // the group falls back to the hash.
     int Listen(sockaddr_in& addr)
     {
         if(m_ServerInterface.m_Channel.Socket == -1)
             return -1;
 
-        if(-1 == bind(m_ServerInterface.m_Channel.Socket, (sockaddr*)&addr, sizeof(sockaddr_in)))
+        int reuse = 1;
+        if((m_bReusePort &&
+            (-1 == setsockopt(m_ServerInterface.m_Channel.Socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(int)) ||
+             -1 == setsockopt(m_ServerInterface.m_Channel.Socket, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(int)))) ||
+           -1 == bind(m_ServerInterface.m_Channel.Socket, (sockaddr*)&addr, sizeof(sockaddr_in)))
         {
             close(m_ServerInterface.m_Channel.Socket);
             m_ServerInterface.m_Channel.Socket = -1;
             return -1;
         }
+
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+        // the program attached here replaces the one of the whole group.
+        if(m_bReusePort && m_bCpuSteering)
+        {
+            sock_filter code[] = {
+                { BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU) },
+                { BPF_RET | BPF_A, 0, 0, 0 }
+            };
+            sock_fprog prog;
+            prog.len = sizeof(code) / sizeof(sock_filter);
+            prog.filter = code;
+            if(-1 == setsockopt(m_ServerInterface.m_Channel.Socket, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(sock_fprog)))
+                LOG("attach reuseport cpu steering fail, %s.", safe_strerror(errno));
+        }
+#endif
+        return 0;
+    }
+
+    inline void SetReusePort(bool enable, bool cpuSteering = false)
+    {
+        m_bReusePort = enable;
+        m_bCpuSteering = cpuSteering;
+    }
+
+    inline bool IsReusePort()
+    {
+        return m_bReusePort;
+    }
+
+    // SO_RXQ_OVFL, every read carries the drop count of the socket, see
+    // GetStats().Drops.
+    int SetDropCounter(bool enable)
+    {
+        int value = enable ? 1 : 0;
+        if(-1 == setsockopt(m_ServerInterface.m_Channel.Socket, SOL_SOCKET, SO_RXQ_OVFL, &value, sizeof(int)))
+            return -1;
+
+        m_bDropCounter = enable;
         return 0;
     }
 
+    // SO_RCVBUF is capped by net.core.rmem_max, SO_RCVBUFFORCE goes past it
+    // with CAP_NET_ADMIN. return the size the kernel took, it doubles the
+    // request for its bookkeeping, or -1.
+    int SetRecvBufferSize(int size)
+    {
+        int fd = m_ServerInterface.m_Channel.Socket;
+        if(-1 == setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(int)))
+            return -1;
+
+        int actual = GetRecvBufferSize();
+        if(actual != -1 && actual < size * 2 &&
+           -1 == setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(int)))
+            LOG("rcvbuf %d capped to %d by net.core.rmem_max.", size, actual / 2);
+        return GetRecvBufferSize();
+    }
+
+    inline int GetRecvBufferSize()
+    {
+        int size = 0;
+        socklen_t len = sizeof(int);
+        if(-1 == getsockopt(m_ServerInterface.m_Channel.Socket, SOL_SOCKET, SO_RCVBUF, &size, &len))
+            return -1;
+        return size;
+    }
+
     void OnWriteable(ServerInterface<ChannelDataT>* pInterface)
     {
     }
 
+    void OnErrorable(ServerInterface<ChannelDataT>* pInterface)
+    {
+        // fetch and clear the pending icmp error, keep the socket.
+        pInterface->m_Channel.GetErrorCode();
+    }
+
     void OnReadable(ServerInterface<ChannelDataT>* pInterface)
+    {
+        if(m_pBatch)
+        {
+            OnReadableBatch(pInterface);
+            return;
+        }
+
+        if(!(m_dwEventFlags & EventScheduler::PollType::ET))
+        {
+            ReadMessage(pInterface);
+            return;
+        }
+
+        // edge-triggered, read until EAGAIN or the wakeup budget is used up.
+        for(uint32_t i = 0; i < m_dwWakeupBudget; ++i)
+        {
+            if(!ReadMessage(pInterface))
+                return;
+        }
+
+        PoolObject<EventScheduler>::Instance().SetReady(pInterface);
+    }
+
+    // one recvmmsg per batch, the wakeup budget counts datagrams.
+    void OnReadableBatch(ServerInterface<ChannelDataT>* pInterface)
+    {
+        if(!(m_dwEventFlags & EventScheduler::PollType::ET))
+        {
+            ReadBatch(pInterface, m_pBatch->dwSize);
+            return;
+        }
+
+        uint32_t dwLeft = m_dwWakeupBudget;
+        while(dwLeft > 0)
+        {
+            uint32_t count = (dwLeft < m_pBatch->dwSize) ? dwLeft : m_pBatch->dwSize;
+            int iRet = ReadBatch(pInterface, count);
+            if(iRet < (int)count)
+                return;
+            dwLeft -= count;
+        }
+
+        PoolObject<EventScheduler>::Instance().SetReady(pInterface);
+    }
+
+    // read up to count datagrams, OnMessage for each, then the replies queued
+    // by Send go out with sendmmsg. return the datagrams read.
+    int ReadBatch(ServerInterface<ChannelDataT>* pInterface, uint32_t count)
+    {
+        UdpBatch* pBatch = m_pBatch;
+        pBatch->ResetRecv(count, m_bGro || m_bDropCounter);
+
+        int iRet = recvmmsg(pInterface->m_Channel.Socket, &pBatch->RecvMsgs[0], count, MSG_DONTWAIT, NULL);
+        ++m_Stats.Reads;
+        if(iRet == -1)
+        {
+            if(GetChannelStatus(-1) == CHANNEL_AGAIN ||
+               errno == ECONNREFUSED || errno == EHOSTUNREACH || errno == ENETUNREACH)
+                return 0;
+            throw InternalException((boost::format("[%s:%d][error] recvmmsg fail, %s.") % __FILE__ % __LINE__ % safe_strerror(errno)).str().c_str());
+        }
+
+        pBatch->bDispatching = true;
+        try
+        {
+            for(int i = 0; i < iRet; ++i)
+            {
+                msghdr& msg = pBatch->RecvMsgs[i].msg_hdr;
+                if(msg.msg_flags & MSG_TRUNC)
+                {
+                    ++m_Stats.Truncated;
+                    continue;
+                }
+
+                pInterface->m_Channel.Address = pBatch->RecvAddrs[i];
+                DispatchMessage(pInterface, (char*)pBatch->RecvIov[i].iov_base, pBatch->dwSlotSize,
+                                pBatch->RecvMsgs[i].msg_len, ReadControl(msg));
+            }
+        }
+        catch(...)
+        {
+            pBatch->bDispatching = false;
+            FlushBatch();
+            throw;
+        }
+        pBatch->bDispatching = false;
+
+        FlushBatch();
+        return iRet;
+    }
+
+    // send the queued replies, a datagram that fails is counted and skipped.
+    void FlushBatch()
+    {
+        UdpBatch* pBatch = m_pBatch;
+
+        uint32_t dwSent = 0;
+        while(dwSent < pBatch->dwSendCount)
+        {
+            int iRet = sendmmsg(m_ServerInterface.m_Channel.Socket, &pBatch->SendMsgs[dwSent], pBatch->dwSendCount - dwSent, 0);
+            ++m_Stats.Writes;
+            if(iRet == -1)
+            {
+                if(errno == EINTR)
+                    continue;
+                ++m_Stats.SendErrors;
+                iRet = 1;
+            }
+            dwSent += iRet;
+        }
+        pBatch->dwSendCount = 0;
+    }
+
+    bool ReadMessage(ServerInterface<ChannelDataT>* pInterface)
     {
         char buffer[65535];
-        IOBuffer in(buffer, 65535);
-        pInterface->m_Channel >> in;
+        char control[UDPSERVER_CONTROL_SIZE];
+
+        msghdr msg;
+        bzero(&msg, sizeof(msghdr));
+
+        msg.msg_name = &pInterface->m_Channel.Address;
+        msg.msg_namelen = sizeof(sockaddr_in);
+
+        iovec iov;
+        iov.iov_base = buffer;
+        iov.iov_len = 65535;
+
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+
+        if(m_bGro || m_bDropCounter)
+        {
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+        }
+
+        ssize_t recvSize = ChannelRecvMsg(pInterface->m_Channel.Socket, &msg, MSG_DONTWAIT, false);
+        ++m_Stats.Reads;
+        if(recvSize == CHANNEL_AGAIN)
+            return false;
+
+        if(recvSize < 0)
+        {
+            // an icmp error of an earlier send, the next datagram is fine.
+            if(errno == ECONNREFUSED || errno == EHOSTUNREACH || errno == ENETUNREACH)
+                return true;
+            throw InternalException((boost::format("[%s:%d][error] recvmsg fail, %s.") % __FILE__ % __LINE__ % safe_strerror(errno)).str().c_str());
+        }
+
+        DispatchMessage(pInterface, buffer, 65535, recvSize, ReadControl(msg));
+        return true;
+    }
 
-        this->OnMessage(pInterface->m_Channel, in);
+    inline uint16_t ReadControl(msghdr& msg)
+    {
+        if(!m_bGro && !m_bDropCounter)
+            return 0;
+
+        uint16_t segmentSize = ReadUdpControl(msg, m_Stats.Drops);
+        return m_bGro ? segmentSize : 0;
+    }
+
+    // OnMessage for a datagram, or for every segment of a GRO read, all of
+    // segmentSize but the last. a segment is its own IOBuffer.
+    inline void DispatchMessage(ServerInterface<ChannelDataT>* pInterface, char* buffer, size_t bufferSize,
+                                size_t size, uint16_t segmentSize)
+    {
+        if(segmentSize == 0 || segmentSize >= size)
+        {
+            ++m_Stats.Messages;
+            IOBuffer in(buffer, bufferSize, size);
+            this->OnMessage(pInterface->m_Channel, in);
+            return;
+        }
+
+        ++m_Stats.Coalesced;
+        for(size_t offset = 0; offset < size; offset += segmentSize)
+        {
+            size_t dwSegmentSize = (size - offset < segmentSize) ? size - offset : segmentSize;
+
+            ++m_Stats.Messages;
+            IOBuffer in(buffer + offset, dwSegmentSize, dwSegmentSize);
+            this->OnMessage(pInterface->m_Channel, in);
+        }
     }
 
     // udp server interface
-    UdpServer()
+    UdpServer() :
+        m_dwEventFlags(0),
+        m_dwWakeupBudget(SERVER_WAKEUP_BUDGET),
+        m_pBatch(NULL),
+        m_bGro(false),
+        m_bGso(true),
+        m_bReusePort(false),
+        m_bCpuSteering(false),
+        m_bDropCounter(false)
     {
+        bzero(&m_Stats, sizeof(UdpServerStats));
+
 #ifdef __USE_GNU
         m_ServerInterface.m_Channel.Socket = socket(PF_INET, SOCK_DGRAM|SOCK_CLOEXEC, 0);
         if(m_ServerInterface.m_Channel.Socket == -1)
@@ -70,32 +478,220 @@ public:
             return;
         }
 #endif
-        m_ServerInterface.m_ReadableCallback = boost::bind(&ServerImplT::OnReadable, reinterpret_cast<ServerImplT*>(this), _1);
-        m_ServerInterface.m_WriteableCallback = boost::bind(&ServerImplT::OnWriteable, reinterpret_cast<ServerImplT*>(this), _1);
+        m_ServerInterface.SetHandler(reinterpret_cast<ServerImplT*>(this));
     }
 
     virtual ~UdpServer()
     {
+        delete m_pBatch;
+    }
+
+    // size > 1 reads up to size datagrams per recvmmsg into preallocated
+    // slots and sends the replies of a batch with one sendmmsg, 0 or 1 reads
+    // one datagram per recvmsg. not while a batch is dispatched.
+    int SetBatch(uint32_t size, uint32_t slotSize = UDPSERVER_BATCH_SLOT_SIZE)
+    {
+        delete m_pBatch;
+        m_pBatch = NULL;
+        if(size <= 1)
+            return 0;
+
+        if(size > UDPSERVER_MAX_BATCH)
+            size = UDPSERVER_MAX_BATCH;
+
+        m_pBatch = new UdpBatch(size, slotSize);
+        if(!m_pBatch->pRecvBuffer || !m_pBatch->pSendBuffer)
+        {
+            delete m_pBatch;
+            m_pBatch = NULL;
+            return -1;
+        }
+        return 0;
+    }
+
+    inline UdpServerStats& GetStats()
+    {
+        return m_Stats;
+    }
+
+    // UDP_GRO, the kernel may hand over same sized datagrams of a peer in one
+    // read, they still come to OnMessage one by one. batch slots should hold
+    // 65535 bytes then. -1 if the kernel has no UDP_GRO, reads stay as they are.
+    int SetGro(bool enable)
+    {
+        int value = enable ? 1 : 0;
+        if(-1 == setsockopt(m_ServerInterface.m_Channel.Socket, SOL_UDP, UDP_GRO, &value, sizeof(int)))
+            return enable ? -1 : 0;
+
+        m_bGro = enable;
+        return 0;
+    }
+
+    // send size bytes to target as datagrams of segmentSize, the last may be
+    // shorter. with UDP_SEGMENT the kernel splits a sendmsg of up to
+    // UDPSERVER_GSO_MAX_SEGMENTS of them, without it, or once the kernel
+    // refused it, every segment is a Send. return size or a ChannelStatus.
+    ssize_t SendSegments(const char* buffer, size_t size, uint16_t segmentSize, sockaddr_in& target)
+    {
+        if(segmentSize == 0)
+            return CHANNEL_ERROR;
+
+        // keep the order with the replies queued before.
+        if(m_pBatch && m_pBatch->dwSendCount > 0 && m_bGso && size > segmentSize)
+            FlushBatch();
+
+        size_t maxSegments = UDPSERVER_MAX_PAYLOAD / segmentSize;
+        if(maxSegments > UDPSERVER_GSO_MAX_SEGMENTS)
+            maxSegments = UDPSERVER_GSO_MAX_SEGMENTS;
+
+        size_t offset = 0;
+        while(offset < size && m_bGso && size - offset > segmentSize && maxSegments > 1)
+        {
+            size_t sendSize = size - offset;
+            if(sendSize > maxSegments * segmentSize)
+                sendSize = maxSegments * segmentSize;
+
+            ssize_t iRet = SendGso(buffer + offset, sendSize, segmentSize, target);
+            if(iRet == CHANNEL_ERROR && (errno == EINVAL || errno == ENOPROTOOPT || errno == EIO || errno == EOPNOTSUPP))
+            {
+                // no UDP_SEGMENT in this kernel or on this route.
+                m_bGso = false;
+                break;
+            }
+            if(iRet < 0)
+                return iRet;
+            offset += sendSize;
+        }
+
+        for(; offset < size; offset += segmentSize)
+        {
+            size_t sendSize = (size - offset < segmentSize) ? size - offset : segmentSize;
+            ssize_t iRet = Send(buffer + offset, sendSize, target);
+            if(iRet < 0)
+                return iRet;
+        }
+        return size;
+    }
+
+    inline bool IsGsoEnabled()
+    {
+        return m_bGso;
+    }
+
+    // edge-triggered registration, the socket is non-blocking and drained up
+    // to budget datagrams per wakeup.
+    int SetEdgeTriggered(bool enable, uint32_t budget = SERVER_WAKEUP_BUDGET)
+    {
+        if(!enable)
+        {
+            m_dwEventFlags = 0;
+            return 0;
+        }
+
+        if(m_ServerInterface.m_Channel.Socket != -1 && SetNonblockFd(m_ServerInterface.m_Channel.Socket) < 0)
+            return -1;
+
+        m_dwEventFlags = EventScheduler::PollType::ET;
+        m_dwWakeupBudget = (budget == 0) ? 1 : budget;
+        return 0;
+    }
+
+    inline uint32_t GetEventFlags()
+    {
+        return m_dwEventFlags;
     }
 
     virtual void OnMessage(ChannelType& channel, IOBuffer& in)
     {
     }
 
+    // the sent size, or a ChannelStatus. from OnMessage in batch mode the
+    // datagram is copied to a reply slot and sent after the batch.
     inline ssize_t Send(IOBuffer& out, sockaddr_in& target)
     {
-        return sendto(m_ServerInterface.m_Channel.Socket, 
-                    out.GetWriteBuffer(), out.GetWriteSize(), 0,
-                    (const sockaddr*)&target, sizeof(sockaddr_in));
+        return Send(out.GetWriteBuffer(), out.GetWriteSize(), target);
+    }
+
+    ssize_t Send(const char* buffer, size_t size, sockaddr_in& target)
+    {
+        UdpBatch* pBatch = m_pBatch;
+        if(pBatch && pBatch->bDispatching && size <= pBatch->dwSlotSize)
+        {
+            if(pBatch->dwSendCount == pBatch->dwSize)
+                FlushBatch();
+
+            uint32_t idx = pBatch->dwSendCount++;
+            memcpy(pBatch->SendIov[idx].iov_base, buffer, size);
+            pBatch->SendIov[idx].iov_len = size;
+            pBatch->SendAddrs[idx] = target;
+            ++m_Stats.Sends;
+            return size;
+        }
+
+        // keep the order with the replies queued before.
+        if(pBatch && pBatch->dwSendCount > 0)
+            FlushBatch();
+
+        ssize_t sendSize = GetChannelStatus(sendto(m_ServerInterface.m_Channel.Socket,
+                                                   buffer, size, 0,
+                                                   (const sockaddr*)&target, sizeof(sockaddr_in)));
+        ++m_Stats.Writes;
+        ++m_Stats.Sends;
+        if(sendSize < 0)
+            ++m_Stats.SendErrors;
+        return sendSize;
     }
 
+    // the read size, or a ChannelStatus.
     inline ssize_t Recv(IOBuffer& in)
     {
-        m_ServerInterface.m_Channel >> in;
-        return in.GetReadSize();
+        return ReadChannel(m_ServerInterface.m_Channel, in);
     }
 
     ServerInterface<ChannelDataT> m_ServerInterface;
+    uint32_t m_dwEventFlags;
+    uint32_t m_dwWakeupBudget;
+    UdpBatch* m_pBatch;
+    UdpServerStats m_Stats;
+    bool m_bGro;
+    bool m_bGso;
+    bool m_bReusePort;
+    bool m_bCpuSteering;
+    bool m_bDropCounter;
+
+private:
+    // one sendmsg, the UDP_SEGMENT cmsg carries the segment size.
+    ssize_t SendGso(const char* buffer, size_t size, uint16_t segmentSize, sockaddr_in& target)
+    {
+        char control[CMSG_SPACE(sizeof(uint16_t))];
+        bzero(control, sizeof(control));
+
+        iovec iov;
+        iov.iov_base = const_cast<char*>(buffer);
+        iov.iov_len = size;
+
+        msghdr msg;
+        bzero(&msg, sizeof(msghdr));
+        msg.msg_name = &target;
+        msg.msg_namelen = sizeof(sockaddr_in);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        cmsghdr* pCmsg = CMSG_FIRSTHDR(&msg);
+        pCmsg->cmsg_level = SOL_UDP;
+        pCmsg->cmsg_type = UDP_SEGMENT;
+        pCmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        *(uint16_t*)CMSG_DATA(pCmsg) = segmentSize;
+
+        ssize_t sendSize = ChannelSendMsg(m_ServerInterface.m_Channel.Socket, &msg, 0);
+        ++m_Stats.Writes;
+        m_Stats.Sends += (size + segmentSize - 1) / segmentSize;
+        if(sendSize < 0)
+            ++m_Stats.SendErrors;
+        return sendSize;
+    }
 };
 
 
@@ -0,0 +1,101 @@
+/*++
+ *
+ * Simple Server Library
+ * Author: NickeyWoo
+ * Date: 2026-10-17
+ *
+--*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <boost/format.hpp>
+#include "BufferPool.hpp"
+
+BufferPool::BufferPool() :
+    m_AllocCount(0),
+    m_HitCount(0),
+    m_UsedSize(0),
+    m_PeakUsedSize(0),
+    m_UsedCount(0)
+{
+    m_pScratch = (char*)malloc(BUFFERPOOL_SCRATCH_SIZE);
+}
+
+BufferPool::~BufferPool()
+{
+    for(uint32_t i = 0; i < BUFFERPOOL_MAX_CLASS; ++i)
+    {
+        for(std::vector<char*>::iterator iter = m_FreeList[i].begin();
+            iter != m_FreeList[i].end();
+            ++iter)
+        {
+            free(*iter);
+        }
+    }
+    free(m_pScratch);
+}
+
+char* BufferPool::Alloc(uint32_t size, uint32_t* pAllocSize)
+{
+    uint32_t chunks = (size + BUFFERPOOL_CHUNK_SIZE - 1) / BUFFERPOOL_CHUNK_SIZE;
+    if(chunks == 0)
+        chunks = 1;
+
+    char* buffer = NULL;
+    if(chunks <= BUFFERPOOL_MAX_CLASS && !m_FreeList[chunks - 1].empty())
+    {
+        buffer = m_FreeList[chunks - 1].back();
+        m_FreeList[chunks - 1].pop_back();
+        ++m_HitCount;
+    }
+    else
+    {
+        buffer = (char*)malloc(chunks * BUFFERPOOL_CHUNK_SIZE);
+        if(!buffer)
+            return NULL;
+    }
+
+    ++m_AllocCount;
+    ++m_UsedCount;
+    m_UsedSize += chunks * BUFFERPOOL_CHUNK_SIZE;
+    if(m_UsedSize > m_PeakUsedSize)
+        m_PeakUsedSize = m_UsedSize;
+
+    *pAllocSize = chunks * BUFFERPOOL_CHUNK_SIZE;
+    return buffer;
+}
+
+void BufferPool::Free(char* buffer, uint32_t size)
+{
+    if(!buffer)
+        return;
+
+    uint32_t chunks = size / BUFFERPOOL_CHUNK_SIZE;
+    --m_UsedCount;
+    m_UsedSize -= size;
+
+    if(chunks >= 1 && chunks <= BUFFERPOOL_MAX_CLASS && m_FreeList[chunks - 1].size() < BUFFERPOOL_MAX_FREE)
+        m_FreeList[chunks - 1].push_back(buffer);
+    else
+        free(buffer);
+}
+
+void BufferPool::Dump(std::string& strDump)
+{
+    uint64_t freeCount = 0;
+    uint64_t freeSize = 0;
+    for(uint32_t i = 0; i < BUFFERPOOL_MAX_CLASS; ++i)
+    {
+        freeCount += m_FreeList[i].size();
+        freeSize += m_FreeList[i].size() * (i + 1) * BUFFERPOOL_CHUNK_SIZE;
+    }
+
+    strDump.append((boost::format("Buffers In Use: %lu, %lu bytes, peak %lu bytes\n") 
+                        % m_UsedCount % m_UsedSize % m_PeakUsedSize).str());
+    strDump.append((boost::format("Free Buffers: %lu, %lu bytes\n") % freeCount % freeSize).str());
+    strDump.append((boost::format("Allocs: %lu, %.02f%% from free list\n") 
+                        % m_AllocCount % (m_AllocCount ? (double)m_HitCount * 100 / m_AllocCount : 0)).str());
+}
+
@@ -22,27 +22,62 @@
 #include "EPoll.hpp"
 
 EPoll::EPoll() :
-    m_epfd(-1)
+    m_epfd(-1),
+    m_MaxEvents(0),
+    m_Ready(0),
+    m_Current(0),
+    m_pEvents(NULL)
 {
 }
 
 EPoll::~EPoll()
 {
+    if(m_pEvents)
+        free(m_pEvents);
 }
 
-int EPoll::CreatePoll()
+int EPoll::CreatePoll(int maxEvents)
 {
+    if(maxEvents <= 0)
+        maxEvents = 1;
+
 #ifdef __USE_GNU
     m_epfd = epoll_create1(EPOLL_CLOEXEC);
 #else
     m_epfd = epoll_create(1000);
 #endif
+    if(m_epfd == -1)
+        return -1;
+
+    // a second CreatePoll replaces the event array.
+    if(m_pEvents)
+        free(m_pEvents);
+
+    m_pEvents = (epoll_event*)malloc(sizeof(epoll_event) * maxEvents);
+    if(m_pEvents == NULL)
+    {
+        close(m_epfd);
+        m_epfd = -1;
+        return -1;
+    }
+
+    bzero(m_pEvents, sizeof(epoll_event) * maxEvents);
+    m_MaxEvents = maxEvents;
+    m_Ready = 0;
+    m_Current = 0;
     return m_epfd;
 }
 
 void EPoll::Close()
 {
     close(m_epfd);
+    m_epfd = -1;
+
+    free(m_pEvents);
+    m_pEvents = NULL;
+    m_MaxEvents = 0;
+    m_Ready = 0;
+    m_Current = 0;
 }
 
 int EPoll::EventCtl(int opeartor, uint32_t events, int fd, void* ptr)
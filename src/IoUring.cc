@@ -0,0 +1,973 @@
+/*++
+ *
+ * Simple Server Library
+ * Author: NickeyWoo
+ * Date: 2026-10-17
+ *
+--*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <linux/io_uring.h>
+#include <algorithm>
+#include "Clock.hpp"
+#include "IoUring.hpp"
+
+#define IOURING_REMOVE_DATA     ((uint64_t)-1)
+#define IOURING_POLL_MASK       (POLLIN | POLLOUT | POLLPRI | POLLRDHUP)
+#define IOURING_GENERATION_MASK 0xFFFFFF
+
+#define IOURING_TYPE_POLL       0
+#define IOURING_TYPE_RECV       1
+#define IOURING_TYPE_ACCEPT     2
+
+// request type, generation and fd of a completion.
+#define IOURING_USERDATA(type, gen, fd)   \
+            (((uint64_t)(type) << 56) | ((uint64_t)((gen) & IOURING_GENERATION_MASK) << 32) | (uint32_t)(fd))
+
+IoUring::IoUring() :
+    m_RingFd(-1),
+    m_MaxEvents(0),
+    m_Ready(0),
+    m_Current(0),
+    m_pEvents(NULL),
+    m_pSqRing(NULL),
+    m_pCqRing(NULL),
+    m_SqRingSize(0),
+    m_CqRingSize(0),
+    m_pSqes(NULL),
+    m_SqesSize(0),
+    m_pSqHead(NULL),
+    m_pSqTail(NULL),
+    m_SqMask(0),
+    m_SqEntries(0),
+    m_SqLocalTail(0),
+    m_pCqHead(NULL),
+    m_pCqTail(NULL),
+    m_CqMask(0),
+    m_pCqes(NULL),
+    m_Batch(0),
+    m_pBufRing(NULL),
+    m_pBuffers(NULL),
+    m_BufTail(0),
+    m_FreeBuffers(0),
+    m_FileTableSize(0),
+    m_bRecvMultishot(false),
+    m_bAcceptMultishot(false)
+{
+}
+
+IoUring::~IoUring()
+{
+    if(m_RingFd != -1)
+        Close();
+}
+
+int IoUring::CreatePoll(int maxEvents)
+{
+    if(maxEvents <= 0)
+        maxEvents = 1;
+
+    io_uring_params params;
+    bzero(&params, sizeof(io_uring_params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = maxEvents * 4;
+#if defined(IORING_SETUP_SINGLE_ISSUER) && defined(IORING_SETUP_DEFER_TASKRUN)
+    params.flags |= IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+#endif
+
+    m_RingFd = syscall(__NR_io_uring_setup, maxEvents, &params);
+    if(m_RingFd == -1 && errno == EINVAL)
+    {
+        // older kernel, retry without task run deferring.
+        bzero(&params, sizeof(io_uring_params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = maxEvents * 4;
+        m_RingFd = syscall(__NR_io_uring_setup, maxEvents, &params);
+    }
+    if(m_RingFd == -1)
+        return -1;
+
+    if(!(params.features & IORING_FEAT_EXT_ARG))
+    {
+        close(m_RingFd);
+        m_RingFd = -1;
+        errno = ENOSYS;
+        return -1;
+    }
+
+    m_SqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    m_CqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if(m_CqRingSize > m_SqRingSize)
+            m_SqRingSize = m_CqRingSize;
+        m_CqRingSize = m_SqRingSize;
+    }
+
+    m_pSqRing = mmap(NULL, m_SqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, m_RingFd, IORING_OFF_SQ_RING);
+    if(m_pSqRing == MAP_FAILED)
+    {
+        m_pSqRing = NULL;
+        Close();
+        return -1;
+    }
+
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+        m_pCqRing = m_pSqRing;
+    else
+    {
+        m_pCqRing = mmap(NULL, m_CqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, m_RingFd, IORING_OFF_CQ_RING);
+        if(m_pCqRing == MAP_FAILED)
+        {
+            m_pCqRing = NULL;
+            Close();
+            return -1;
+        }
+    }
+
+    m_SqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    m_pSqes = (io_uring_sqe*)mmap(NULL, m_SqesSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, m_RingFd, IORING_OFF_SQES);
+    if(m_pSqes == MAP_FAILED)
+    {
+        m_pSqes = NULL;
+        Close();
+        return -1;
+    }
+
+    char* pSqRing = (char*)m_pSqRing;
+    m_pSqHead = (uint32_t*)(pSqRing + params.sq_off.head);
+    m_pSqTail = (uint32_t*)(pSqRing + params.sq_off.tail);
+    m_SqMask = *(uint32_t*)(pSqRing + params.sq_off.ring_mask);
+    m_SqEntries = params.sq_entries;
+    m_SqLocalTail = *m_pSqTail;
+
+    uint32_t* pArray = (uint32_t*)(pSqRing + params.sq_off.array);
+    for(uint32_t i = 0; i < m_SqEntries; ++i)
+        pArray[i] = i;
+
+    char* pCqRing = (char*)m_pCqRing;
+    m_pCqHead = (uint32_t*)(pCqRing + params.cq_off.head);
+    m_pCqTail = (uint32_t*)(pCqRing + params.cq_off.tail);
+    m_CqMask = *(uint32_t*)(pCqRing + params.cq_off.ring_mask);
+    m_pCqes = (io_uring_cqe*)(pCqRing + params.cq_off.cqes);
+
+    m_pEvents = (epoll_event*)malloc(sizeof(epoll_event) * maxEvents);
+    if(m_pEvents == NULL)
+    {
+        Close();
+        return -1;
+    }
+
+    bzero(m_pEvents, sizeof(epoll_event) * maxEvents);
+    m_MaxEvents = maxEvents;
+    m_Ready = 0;
+    m_Current = 0;
+
+    // without them RECV and ACCEPT registrations fall back to poll requests.
+    SetupBuffers();
+    SetupFiles();
+    m_bAcceptMultishot = true;
+    return m_RingFd;
+}
+
+int IoUring::Register(uint32_t op, void* arg, uint32_t count)
+{
+    return syscall(__NR_io_uring_register, m_RingFd, op, arg, count);
+}
+
+void IoUring::SetupBuffers()
+{
+    size_t ringSize = IOURING_BUFFER_COUNT * sizeof(io_uring_buf);
+    void* pRing = mmap(NULL, ringSize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_POPULATE, -1, 0);
+    if(pRing == MAP_FAILED)
+        return;
+
+    char* pBuffers = (char*)malloc((size_t)IOURING_BUFFER_COUNT * IOURING_BUFFER_SIZE);
+    if(pBuffers == NULL)
+    {
+        munmap(pRing, ringSize);
+        return;
+    }
+
+    io_uring_buf_reg reg;
+    bzero(&reg, sizeof(io_uring_buf_reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)pRing;
+    reg.ring_entries = IOURING_BUFFER_COUNT;
+    reg.bgid = 0;
+    if(Register(IORING_REGISTER_PBUF_RING, &reg, 1) == -1)
+    {
+        free(pBuffers);
+        munmap(pRing, ringSize);
+        return;
+    }
+
+    m_pBufRing = (io_uring_buf_ring*)pRing;
+    m_pBuffers = pBuffers;
+    m_BufTail = 0;
+    m_FreeBuffers = 0;
+    m_BufferNext.assign(IOURING_BUFFER_COUNT, -1);
+    m_BufferLength.assign(IOURING_BUFFER_COUNT, 0);
+    for(int bid = 0; bid < IOURING_BUFFER_COUNT; ++bid)
+        RecycleBuffer(bid);
+    m_bRecvMultishot = true;
+}
+
+void IoUring::SetupFiles()
+{
+    uint32_t size = IOURING_MAX_FILES;
+    rlimit rl;
+    if(getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < size)
+        size = rl.rlim_cur;
+
+    io_uring_rsrc_register reg;
+    bzero(&reg, sizeof(io_uring_rsrc_register));
+    reg.nr = size;
+    reg.flags = IORING_RSRC_REGISTER_SPARSE;
+    if(Register(IORING_REGISTER_FILES2, &reg, sizeof(io_uring_rsrc_register)) == 0)
+        m_FileTableSize = size;
+}
+
+// the slot of a socket is its fd, -1 clears it.
+bool IoUring::UpdateFile(int fd, int file)
+{
+    io_uring_files_update update;
+    bzero(&update, sizeof(io_uring_files_update));
+    update.offset = fd;
+    update.fds = (uint64_t)(uintptr_t)&file;
+    return (Register(IORING_REGISTER_FILES_UPDATE, &update, 1) == 1);
+}
+
+void IoUring::RecycleBuffer(int bid)
+{
+    // not m_pBufRing->bufs, the flexible array of the header is placed
+    // after an empty struct that takes space in c++.
+    io_uring_buf* pBuf = (io_uring_buf*)m_pBufRing + (m_BufTail & (IOURING_BUFFER_COUNT - 1));
+    pBuf->addr = (uint64_t)(uintptr_t)(m_pBuffers + (size_t)bid * IOURING_BUFFER_SIZE);
+    pBuf->len = IOURING_BUFFER_SIZE;
+    pBuf->bid = bid;
+    __atomic_store_n(&m_pBufRing->tail, ++m_BufTail, __ATOMIC_RELEASE);
+    ++m_FreeBuffers;
+}
+
+// give back what a removed socket did not read.
+void IoUring::DropPending(int fd)
+{
+    PollEntry& entry = m_Entries[fd];
+    while(entry.PendingHead != -1)
+    {
+        int bid = entry.PendingHead;
+        entry.PendingHead = m_BufferNext[bid];
+        RecycleBuffer(bid);
+    }
+    entry.PendingTail = -1;
+    entry.PendingOffset = 0;
+    entry.Eof = false;
+    entry.RecvError = 0;
+    entry.NewData = false;
+
+    std::map<int, std::deque<int> >::iterator iter = m_AcceptQueues.find(fd);
+    if(iter != m_AcceptQueues.end())
+    {
+        for(std::deque<int>::iterator fdIter = iter->second.begin(); fdIter != iter->second.end(); ++fdIter)
+            close(*fdIter);
+        m_AcceptQueues.erase(iter);
+    }
+}
+
+void IoUring::Close()
+{
+    if(m_pSqes)
+        munmap(m_pSqes, m_SqesSize);
+    if(m_pCqRing && m_pCqRing != m_pSqRing)
+        munmap(m_pCqRing, m_CqRingSize);
+    if(m_pSqRing)
+        munmap(m_pSqRing, m_SqRingSize);
+    if(m_RingFd != -1)
+        close(m_RingFd);
+
+    m_pSqes = NULL;
+    m_pCqRing = NULL;
+    m_pSqRing = NULL;
+    m_RingFd = -1;
+
+    for(std::map<int, std::deque<int> >::iterator iter = m_AcceptQueues.begin(); iter != m_AcceptQueues.end(); ++iter)
+    {
+        for(std::deque<int>::iterator fdIter = iter->second.begin(); fdIter != iter->second.end(); ++fdIter)
+            close(*fdIter);
+    }
+    m_AcceptQueues.clear();
+
+    if(m_pBufRing)
+        munmap(m_pBufRing, IOURING_BUFFER_COUNT * sizeof(io_uring_buf));
+    free(m_pBuffers);
+    m_pBufRing = NULL;
+    m_pBuffers = NULL;
+    m_FreeBuffers = 0;
+    m_BufferNext.clear();
+    m_BufferLength.clear();
+    m_FileTableSize = 0;
+    m_bRecvMultishot = false;
+    m_bAcceptMultishot = false;
+
+    free(m_pEvents);
+    m_pEvents = NULL;
+    m_MaxEvents = 0;
+    m_Ready = 0;
+    m_Current = 0;
+
+    m_Entries.clear();
+    m_RearmList.clear();
+    m_RecvRearmList.clear();
+    m_CompletionList.clear();
+}
+
+io_uring_sqe* IoUring::GetSqe()
+{
+    uint32_t pending = m_SqLocalTail - __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE);
+    if(pending >= m_SqEntries)
+    {
+        // submission queue is full, flush it without waiting.
+        if(Enter(pending, 0, 0) == -1)
+            return NULL;
+
+        pending = m_SqLocalTail - __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE);
+        if(pending >= m_SqEntries)
+        {
+            errno = EBUSY;
+            return NULL;
+        }
+    }
+
+    io_uring_sqe* pSqe = &m_pSqes[m_SqLocalTail & m_SqMask];
+    bzero(pSqe, sizeof(io_uring_sqe));
+    return pSqe;
+}
+
+void IoUring::PrepPollAdd(int fd)
+{
+    PollEntry& entry = m_Entries[fd];
+
+    // input of a RECV or ACCEPT socket comes with its completions, it is
+    // polled only for output or errors asked with ERR, like the MSG_ZEROCOPY
+    // completions of the error queue. other sockets are polled even for no
+    // events, error and hangup are always reported like by epoll.
+    uint32_t events = entry.Events & IOURING_POLL_MASK;
+    if(entry.Mode)
+        events &= ~(POLLIN | POLLPRI | POLLRDHUP);
+    if(events == 0 && entry.Mode && !(entry.Events & ERR))
+    {
+        entry.Armed = false;
+        return;
+    }
+
+    io_uring_sqe* pSqe = GetSqe();
+    if(pSqe == NULL)
+    {
+        // retry on next wait.
+        m_RearmList.push_back(fd);
+        return;
+    }
+
+    pSqe->opcode = IORING_OP_POLL_ADD;
+    pSqe->fd = fd;
+    pSqe->poll32_events = events;
+    if(entry.Events & EPOLLET)
+        pSqe->len = IORING_POLL_ADD_MULTI;
+    pSqe->user_data = IOURING_USERDATA(IOURING_TYPE_POLL, entry.Generation, fd);
+
+    __atomic_store_n(m_pSqTail, ++m_SqLocalTail, __ATOMIC_RELEASE);
+    entry.Armed = true;
+}
+
+void IoUring::PrepPollRemove(int fd)
+{
+    PollEntry& entry = m_Entries[fd];
+    entry.Armed = false;
+
+    io_uring_sqe* pSqe = GetSqe();
+    if(pSqe == NULL)
+        return;     // the stale completion is dropped by generation check.
+
+    pSqe->opcode = IORING_OP_POLL_REMOVE;
+    pSqe->fd = -1;
+    pSqe->addr = IOURING_USERDATA(IOURING_TYPE_POLL, entry.Generation, fd);
+    pSqe->user_data = IOURING_REMOVE_DATA;
+
+    __atomic_store_n(m_pSqTail, ++m_SqLocalTail, __ATOMIC_RELEASE);
+}
+
+void IoUring::PrepRecv(int fd)
+{
+    PollEntry& entry = m_Entries[fd];
+
+    io_uring_sqe* pSqe = GetSqe();
+    if(pSqe == NULL)
+    {
+        m_RecvRearmList.push_back(fd);
+        return;
+    }
+
+    pSqe->fd = fd;
+    if(entry.Fixed)
+        pSqe->flags = IOSQE_FIXED_FILE;
+
+    if(entry.Mode == RECV)
+    {
+        pSqe->opcode = IORING_OP_RECV;
+        pSqe->ioprio = IORING_RECV_MULTISHOT;
+        pSqe->flags |= IOSQE_BUFFER_SELECT;
+        pSqe->buf_group = 0;
+        pSqe->user_data = IOURING_USERDATA(IOURING_TYPE_RECV, entry.RecvGeneration, fd);
+    }
+    else
+    {
+        pSqe->opcode = IORING_OP_ACCEPT;
+        pSqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        pSqe->accept_flags = entry.AcceptFlags;
+        pSqe->user_data = IOURING_USERDATA(IOURING_TYPE_ACCEPT, entry.RecvGeneration, fd);
+    }
+
+    __atomic_store_n(m_pSqTail, ++m_SqLocalTail, __ATOMIC_RELEASE);
+    entry.RecvArmed = true;
+}
+
+void IoUring::PrepCancel(int fd)
+{
+    PollEntry& entry = m_Entries[fd];
+    entry.RecvArmed = false;
+
+    io_uring_sqe* pSqe = GetSqe();
+    if(pSqe == NULL)
+        return;
+
+    pSqe->opcode = IORING_OP_ASYNC_CANCEL;
+    pSqe->fd = -1;
+    pSqe->addr = IOURING_USERDATA((entry.Mode == RECV) ? IOURING_TYPE_RECV : IOURING_TYPE_ACCEPT, entry.RecvGeneration, fd);
+    pSqe->user_data = IOURING_REMOVE_DATA;
+
+    __atomic_store_n(m_pSqTail, ++m_SqLocalTail, __ATOMIC_RELEASE);
+}
+
+int IoUring::EventCtl(int opeartor, uint32_t events, int fd, void* ptr)
+{
+    if(fd < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    if((size_t)fd >= m_Entries.size())
+    {
+        PollEntry entry;
+        bzero(&entry, sizeof(PollEntry));
+        entry.PendingHead = -1;
+        entry.PendingTail = -1;
+        m_Entries.resize(fd + 1, entry);
+    }
+
+    PollEntry& entry = m_Entries[fd];
+    switch(opeartor)
+    {
+    case ADD:
+        if(entry.Active)
+        {
+            errno = EEXIST;
+            return -1;
+        }
+        entry.Active = true;
+        entry.Ptr = ptr;
+        entry.Events = events & ~(RECV | ACCEPT);
+        ++entry.Generation;
+        ++entry.RecvGeneration;
+
+        entry.RecvCancelled = false;
+        entry.Mode = 0;
+        if((events & RECV) && m_bRecvMultishot)
+            entry.Mode = RECV;
+        else if((events & ACCEPT) && m_bAcceptMultishot)
+        {
+            entry.Mode = ACCEPT;
+            entry.AcceptFlags = SOCK_CLOEXEC | ((events & ET) ? SOCK_NONBLOCK : 0);
+        }
+
+        if(entry.Mode)
+        {
+            entry.Fixed = ((uint32_t)fd < m_FileTableSize && UpdateFile(fd, fd));
+            PrepRecv(fd);
+        }
+        PrepPollAdd(fd);
+        return 0;
+
+    case MOD:
+        if(!entry.Active)
+        {
+            errno = ENOENT;
+            return -1;
+        }
+        if(entry.Armed)
+            PrepPollRemove(fd);
+        entry.Ptr = ptr;
+        entry.Events = events & ~(RECV | ACCEPT);
+        ++entry.Generation;
+        PrepPollAdd(fd);
+
+        // a recv without IN would fill the shared buffers for a paused
+        // socket. it is cancelled and armed again once IN is back, the data
+        // received until the cancel stays pending.
+        if(entry.Mode == RECV)
+        {
+            if(!(entry.Events & IN) && entry.RecvArmed)
+            {
+                PrepCancel(fd);
+                entry.RecvCancelled = true;
+            }
+            else if((entry.Events & IN) && !entry.RecvArmed && !entry.RecvCancelled)
+                m_RecvRearmList.push_back(fd);
+        }
+
+        // like epoll, a modified registration reports what is already there.
+        if(entry.Mode && (entry.Events & IN) && HasPending(fd))
+        {
+            entry.NewData = true;
+            if(!entry.Listed)
+            {
+                entry.Listed = true;
+                m_CompletionList.push_back(fd);
+            }
+        }
+        return 0;
+
+    case DEL:
+        if(!entry.Active)
+        {
+            errno = ENOENT;
+            return -1;
+        }
+        if(entry.Armed)
+            PrepPollRemove(fd);
+        if(entry.Mode)
+        {
+            if(entry.RecvArmed)
+                PrepCancel(fd);
+            DropPending(fd);
+            if(entry.Fixed)
+                UpdateFile(fd, -1);
+            entry.Fixed = false;
+            entry.Mode = 0;
+        }
+        entry.Active = false;
+        entry.RecvCancelled = false;
+        entry.Ptr = NULL;
+        entry.ReportBatch = 0;
+        ++entry.Generation;
+        ++entry.RecvGeneration;
+        return 0;
+    }
+
+    errno = EINVAL;
+    return -1;
+}
+
+int IoUring::Enter(uint32_t submit, uint32_t wait, int timeout)
+{
+    __kernel_timespec ts;
+    io_uring_getevents_arg arg;
+    bzero(&arg, sizeof(io_uring_getevents_arg));
+
+    if(wait > 0 && timeout >= 0)
+    {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+    }
+
+    int ret = syscall(__NR_io_uring_enter, m_RingFd, submit, wait,
+                      IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(io_uring_getevents_arg));
+    if(ret == -1 && (errno == ETIME || errno == EBUSY))
+        return 0;
+    return ret;
+}
+
+int IoUring::Harvest()
+{
+    uint32_t head = *m_pCqHead;
+    uint32_t tail = __atomic_load_n(m_pCqTail, __ATOMIC_ACQUIRE);
+    while(head != tail && m_Ready < m_MaxEvents)
+    {
+        io_uring_cqe* pCqe = &m_pCqes[head & m_CqMask];
+        ++head;
+
+        if(pCqe->user_data == IOURING_REMOVE_DATA)
+            continue;
+
+        uint32_t fd = (uint32_t)pCqe->user_data;
+        uint32_t gen = (uint32_t)(pCqe->user_data >> 32) & IOURING_GENERATION_MASK;
+        uint32_t type = (uint32_t)(pCqe->user_data >> 56);
+        if(type != IOURING_TYPE_POLL)
+        {
+            Complete(type, gen, fd, pCqe->res, pCqe->flags);
+            continue;
+        }
+
+        if(fd >= m_Entries.size())
+            continue;
+
+        PollEntry& entry = m_Entries[fd];
+        if(!entry.Active || (entry.Generation & IOURING_GENERATION_MASK) != gen)
+            continue;
+
+        if(pCqe->res == -ECANCELED)
+        {
+            entry.Armed = false;
+            m_RearmList.push_back(fd);
+            continue;
+        }
+
+        uint32_t events = (pCqe->res < 0) ? (uint32_t)ERR : (uint32_t)pCqe->res;
+        if(entry.Mode)
+        {
+            // hangup and errors of a RECV or ACCEPT socket end its request,
+            // they are reported in order after the received data. ERR stays
+            // for the error queue when it was asked for.
+            events &= (entry.Events & ERR) ? (uint32_t)(OUT | ERR) : (uint32_t)OUT;
+            if(events == 0)
+            {
+                entry.Armed = false;
+                continue;
+            }
+        }
+
+        if(!(pCqe->flags & IORING_CQE_F_MORE))
+        {
+            entry.Armed = false;
+            m_RearmList.push_back(fd);
+        }
+        AddEvent(fd, events);
+    }
+    __atomic_store_n(m_pCqHead, head, __ATOMIC_RELEASE);
+
+    Collect();
+    return m_Ready;
+}
+
+void IoUring::Complete(uint32_t type, uint32_t gen, uint32_t fd, int res, uint32_t flags)
+{
+    int bid = (flags & IORING_CQE_F_BUFFER) ? (int)(flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+    if(bid != -1)
+        --m_FreeBuffers;
+
+    uint32_t mode = (type == IOURING_TYPE_RECV) ? (uint32_t)RECV : (uint32_t)ACCEPT;
+    if(fd >= m_Entries.size() || !m_Entries[fd].Active || m_Entries[fd].Mode != mode ||
+       (m_Entries[fd].RecvGeneration & IOURING_GENERATION_MASK) != gen)
+    {
+        // completion of a removed socket.
+        if(bid != -1)
+            RecycleBuffer(bid);
+        else if(type == IOURING_TYPE_ACCEPT && res >= 0)
+            close(res);
+        return;
+    }
+
+    PollEntry& entry = m_Entries[fd];
+    if(!(flags & IORING_CQE_F_MORE))
+    {
+        entry.RecvArmed = false;
+        entry.RecvCancelled = false;
+    }
+
+    if(res == -EINVAL && !(flags & IORING_CQE_F_MORE))
+    {
+        // the kernel has no multishot form, poll the socket from now on.
+        if(mode == RECV)
+            m_bRecvMultishot = false;
+        else
+            m_bAcceptMultishot = false;
+
+        if(entry.Fixed)
+            UpdateFile(fd, -1);
+        entry.Fixed = false;
+        entry.Mode = 0;
+        ++entry.RecvGeneration;
+
+        if(entry.Armed)
+            PrepPollRemove(fd);
+        ++entry.Generation;
+        PrepPollAdd(fd);
+        return;
+    }
+
+    bool bNew = false;
+    if(mode == RECV)
+    {
+        if(bid != -1 && res > 0)
+        {
+            m_BufferLength[bid] = res;
+            m_BufferNext[bid] = -1;
+            if(entry.PendingTail == -1)
+                entry.PendingHead = bid;
+            else
+                m_BufferNext[entry.PendingTail] = bid;
+            entry.PendingTail = bid;
+            bNew = true;
+        }
+        else
+        {
+            if(bid != -1)
+                RecycleBuffer(bid);
+
+            if(res == 0)
+            {
+                entry.Eof = true;
+                bNew = true;
+            }
+            else if(res < 0 && res != -ENOBUFS && res != -ECANCELED && res != -EINTR)
+            {
+                entry.RecvError = -res;
+                bNew = true;
+            }
+        }
+    }
+    else if(res >= 0)
+    {
+        m_AcceptQueues[fd].push_back(res);
+        bNew = true;
+    }
+
+    // out of buffers or ended by the kernel, armed again before next wait.
+    if(!entry.RecvArmed && !entry.RecvCancelled && !entry.Eof && entry.RecvError == 0)
+        m_RecvRearmList.push_back(fd);
+
+    if(bNew)
+    {
+        entry.NewData = true;
+        if(!entry.Listed)
+        {
+            entry.Listed = true;
+            m_CompletionList.push_back(fd);
+        }
+    }
+}
+
+// report IN of the sockets with received data or queued connections,
+// level-triggered ones while something is left, edge-triggered ones once
+// per completion.
+void IoUring::Collect()
+{
+    size_t keep = 0;
+    for(size_t i = 0; i < m_CompletionList.size(); ++i)
+    {
+        int fd = m_CompletionList[i];
+        PollEntry& entry = m_Entries[fd];
+        if(!entry.Active || !entry.Mode || !(entry.Events & IN) || !HasPending(fd) ||
+           ((entry.Events & ET) && !entry.NewData))
+        {
+            entry.Listed = false;
+            continue;
+        }
+
+        if(!AddEvent(fd, IN))
+        {
+            m_CompletionList[keep++] = fd;
+            continue;
+        }
+
+        entry.NewData = false;
+        if(entry.Events & ET)
+            entry.Listed = false;
+        else
+            m_CompletionList[keep++] = fd;
+    }
+    m_CompletionList.resize(keep);
+}
+
+// events of one fd in a batch are merged into one slot.
+bool IoUring::AddEvent(int fd, uint32_t events)
+{
+    PollEntry& entry = m_Entries[fd];
+    if(entry.ReportBatch == m_Batch)
+    {
+        m_pEvents[entry.ReportIndex].events |= events;
+        return true;
+    }
+
+    if(m_Ready >= m_MaxEvents)
+        return false;
+
+    entry.ReportBatch = m_Batch;
+    entry.ReportIndex = m_Ready;
+
+    epoll_event& ev = m_pEvents[m_Ready++];
+    ev.events = events;
+    ev.data.ptr = entry.Ptr;
+    return true;
+}
+
+ssize_t IoUring::Recv(int fd, iovec* iov, int count, int flags)
+{
+    if(fd < 0 || (size_t)fd >= m_Entries.size() || m_Entries[fd].Mode != RECV)
+    {
+        if(count == 1)
+            return ChannelRecv(fd, (char*)iov[0].iov_base, iov[0].iov_len, flags);
+
+        msghdr msg;
+        bzero(&msg, sizeof(msghdr));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        return ChannelRecvMsg(fd, &msg, flags, true);
+    }
+
+    PollEntry& entry = m_Entries[fd];
+    ssize_t size = 0;
+    size_t offset = 0;
+    int i = 0;
+    while(i < count && entry.PendingHead != -1)
+    {
+        int bid = entry.PendingHead;
+        size_t copySize = std::min((size_t)(m_BufferLength[bid] - entry.PendingOffset), iov[i].iov_len - offset);
+        memcpy((char*)iov[i].iov_base + offset, m_pBuffers + (size_t)bid * IOURING_BUFFER_SIZE + entry.PendingOffset, copySize);
+
+        size += copySize;
+        offset += copySize;
+        entry.PendingOffset += copySize;
+
+        if(offset == iov[i].iov_len)
+        {
+            ++i;
+            offset = 0;
+        }
+
+        if(entry.PendingOffset == m_BufferLength[bid])
+        {
+            entry.PendingHead = m_BufferNext[bid];
+            if(entry.PendingHead == -1)
+                entry.PendingTail = -1;
+            entry.PendingOffset = 0;
+            RecycleBuffer(bid);
+        }
+    }
+
+    if(size > 0)
+        return size;
+    if(entry.RecvError != 0)
+    {
+        errno = entry.RecvError;
+        return CHANNEL_ERROR;
+    }
+    if(entry.Eof)
+        return CHANNEL_CLOSED;
+
+    errno = EAGAIN;
+    return CHANNEL_AGAIN;
+}
+
+#ifdef __USE_GNU
+int IoUring::Accept(int fd, sockaddr_in* addr, int flags)
+{
+    socklen_t len = sizeof(sockaddr_in);
+    if(fd < 0 || (size_t)fd >= m_Entries.size() || m_Entries[fd].Mode != ACCEPT)
+        return accept4(fd, (sockaddr*)addr, &len, flags);
+
+    std::map<int, std::deque<int> >::iterator iter = m_AcceptQueues.find(fd);
+    if(iter == m_AcceptQueues.end() || iter->second.empty())
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    int clifd = iter->second.front();
+    iter->second.pop_front();
+
+    if(addr && getpeername(clifd, (sockaddr*)addr, &len) == -1)
+        bzero(addr, sizeof(sockaddr_in));
+
+    // the request was armed with the flags of the registration.
+    if((flags ^ m_Entries[fd].AcceptFlags) & SOCK_NONBLOCK)
+    {
+        int fl = fcntl(clifd, F_GETFL);
+        fcntl(clifd, F_SETFL, (flags & SOCK_NONBLOCK) ? (fl | O_NONBLOCK) : (fl & ~O_NONBLOCK));
+    }
+    return clifd;
+}
+#endif
+
+int IoUring::WaitEvent(int timeout)
+{
+    m_Ready = 0;
+    m_Current = 0;
+    if(++m_Batch == 0)
+        m_Batch = 1;
+
+    // re-arm oneshot polls fired in the last batch, level-triggered
+    // readiness is checked again when the request is armed.
+    if(!m_RearmList.empty())
+    {
+        std::vector<int> vRearm;
+        vRearm.swap(m_RearmList);
+        for(std::vector<int>::iterator iter = vRearm.begin(); iter != vRearm.end(); ++iter)
+        {
+            PollEntry& entry = m_Entries[*iter];
+            if(entry.Active && !entry.Armed)
+                PrepPollAdd(*iter);
+        }
+    }
+
+    // multishot requests ended by the kernel, a recv waits for free buffers.
+    if(!m_RecvRearmList.empty())
+    {
+        std::vector<int> vRearm;
+        vRearm.swap(m_RecvRearmList);
+        for(std::vector<int>::iterator iter = vRearm.begin(); iter != vRearm.end(); ++iter)
+        {
+            PollEntry& entry = m_Entries[*iter];
+            if(!entry.Active || !entry.Mode || entry.RecvArmed || entry.RecvCancelled || entry.Eof || entry.RecvError != 0 ||
+               (entry.Mode == RECV && !(entry.Events & IN)))
+                continue;
+
+            if(entry.Mode == RECV && m_FreeBuffers == 0)
+                m_RecvRearmList.push_back(*iter);
+            else
+                PrepRecv(*iter);
+        }
+    }
+
+    timeval tvs;
+    if(timeout > 0)
+        gettimeofday(&tvs, NULL);
+
+    int remain = timeout;
+    while(true)
+    {
+        uint32_t pending = m_SqLocalTail - __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE);
+        uint32_t wait = (remain == 0 || Harvest() > 0) ? 0 : 1;
+
+        if(-1 == Enter(pending, wait, remain))
+            return -1;
+
+        if(Harvest() > 0 || remain == 0)
+            return m_Ready;
+
+        if(remain > 0)
+        {
+            timeval tve;
+            gettimeofday(&tve, NULL);
+            remain = timeout - (int)CLOCK_COMPUTE_TIMESPAN(tvs, tve);
+            if(remain <= 0)
+                return 0;
+        }
+    }
+}
+
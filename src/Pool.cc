@@ -35,7 +35,10 @@ ProcessPool& ProcessPool::Instance()
 ProcessPool::ProcessPool() :
     m_bStartup(false),
     m_id(0),
-    m_IdleTimeout(-1)
+    m_IdleTimeout(-1),
+    m_MaxEvents(EPOLL_DEFAULT_MAXEVENTS),
+    m_BusyPollTime(0),
+    m_SocketBusyPoll(0)
 {
 }
 
@@ -54,10 +57,11 @@ int ProcessPool::Startup(uint32_t num)
     }
 
     EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
-    if(scheduler.CreateScheduler() == -1)
+    if(scheduler.CreateScheduler(m_MaxEvents) == -1)
         return -1;
 
     scheduler.SetIdleTimeout(m_IdleTimeout);
+    scheduler.SetBusyPoll(m_BusyPollTime, m_SocketBusyPoll);
 
     m_bStartup = true;
     for(std::list<boost::function<bool(void)> >::iterator iter = m_StartupCallbackList.begin();
@@ -84,6 +88,7 @@ ThreadPool& ThreadPool::Instance()
 int ThreadPool::Startup(uint32_t num)
 {
     m_bStartup = true;
+    m_SchedulerList.resize((num == 0) ? 1 : num, NULL);
 
     for(uint32_t i = 1; i < num; ++i)
     {
@@ -121,10 +126,15 @@ void* ThreadPool::ThreadProc(void* paramenter)
     *pID = static_cast<uint32_t>(reinterpret_cast<long>(paramenter));
 
     EventScheduler& scheduler = PoolObject<EventScheduler>::Instance();
-    if(scheduler.CreateScheduler() == -1)
+    if(scheduler.CreateScheduler(ThreadPool::Instance().m_MaxEvents) == -1)
         return NULL;
 
+    std::vector<EventScheduler*>& schedulers = ThreadPool::Instance().m_SchedulerList;
+    if(*pID < schedulers.size())
+        (void)__sync_lock_test_and_set(&schedulers[*pID], &scheduler);
+
     scheduler.SetIdleTimeout(ThreadPool::Instance().m_IdleTimeout);
+    scheduler.SetBusyPoll(ThreadPool::Instance().m_BusyPollTime, ThreadPool::Instance().m_SocketBusyPoll);
 
     std::list<boost::function<bool(void)> >& list = ThreadPool::Instance().m_StartupCallbackList;
     for(std::list<boost::function<bool(void)> >::iterator iter = list.begin();
@@ -155,7 +165,10 @@ uint32_t ThreadPool::GetID()
 
 ThreadPool::ThreadPool() :
     m_bStartup(false),
-    m_IdleTimeout(-1)
+    m_IdleTimeout(-1),
+    m_MaxEvents(EPOLL_DEFAULT_MAXEVENTS),
+    m_BusyPollTime(0),
+    m_SocketBusyPoll(0)
 {
 }
 
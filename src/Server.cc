@@ -47,3 +47,15 @@ int SetCloexecFd(int fd, int flags)
     return 0;
 }
 
+int SetNonblockFd(int fd)
+{
+    int fl = fcntl(fd, F_GETFL, 0);
+    if(fl == -1)
+        return -1;
+
+    if(-1 == fcntl(fd, F_SETFL, fl | O_NONBLOCK))
+        return -1;
+
+    return 0;
+}
+